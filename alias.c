@@ -10,11 +10,14 @@
 #include <stdbool.h>
 #include "shimming.h"
 #include "alias.h"
+#include "batch.h"
+#include "stats.h"
 #include "util.h"
 
 /* hash table/linked list, alias -> (size, origin) */
 struct uk_list_head lookup[LOOKUP_SIZE] = {0};
 static UK_LIST_HEAD(afreelist);
+static UK_LIST_HEAD(abatches);
 
 static inline void alias_clear(struct alias *a)
 {
@@ -26,17 +29,45 @@ static inline void alias_clear(struct alias *a)
 static void alias_batch_alloc(void)
 {
   dprintf("Allocating a new batch of alias structs\n");
-  struct alias *aliases = shimmed->palloc(shimmed, 1);
-  size_t nr_aliases = (__PAGE_SIZE << 1) / sizeof(struct alias);
+  struct batch *b = shimmed->palloc(shimmed, BATCH_ORDER);
+  struct alias *aliases = BATCH_FIRST(b, struct alias);
 
-  UK_ASSERT(aliases);
+  UK_ASSERT(b);
+  UK_ASSERT(batch_of(b) == b);
+  STAT_METADATA_PAGES(POW2(BATCH_ORDER));
 
-  for (unsigned i = 0; i < nr_aliases; i++) {
+  b->used = 0;
+  uk_list_add(&b->list, &abatches);
+
+  for (unsigned i = 0; i < BATCH_ENTRIES(struct alias); i++) {
     alias_clear(&aliases[i]);
     uk_list_add(&aliases[i].list, &afreelist);
   }
 }
 
+size_t alias_shrink(void)
+{
+  struct batch *b, *next;
+  size_t pages = 0;
+
+  uk_list_for_each_entry_safe(b, next, &abatches, list) {
+    if (b->used)
+      continue;
+
+    /* all of them are on the freelist */
+    struct alias *aliases = BATCH_FIRST(b, struct alias);
+    for (unsigned i = 0; i < BATCH_ENTRIES(struct alias); i++)
+      uk_list_del(&aliases[i].list);
+
+    uk_list_del(&b->list);
+    shimmed->pfree(shimmed, b, BATCH_ORDER);
+    STAT_METADATA_PAGES(-POW2(BATCH_ORDER));
+    pages += POW2(BATCH_ORDER);
+  }
+
+  return pages;
+}
+
 void alias_init(void)
 {
   dprintf("Initialising all lists\n");
@@ -89,30 +120,24 @@ void alias_register(uintptr_t addr, uintptr_t alias, size_t size)
   uk_list_del(&a->list);
   *a = (struct alias){.size = size, .alias = alias, .origin = addr};
   uk_list_add(&a->list, &lookup[key]);
+  batch_of(a)->used++;
+  STAT_ALIAS(1);
 }
 
 /*
- * Guarantees the mapping is no longer in the allocated list.
- *
- * returns whether a mapping has been removed
+ * unlinks an alias alias_search found and puts it back on the freelist, no
+ * second walk through the bucket needed
  */
-bool alias_unregister(uintptr_t alias)
+void alias_release(const struct alias *a)
 {
-  dprintf("alias_unregister(%p)\n", (void *) alias);
-  // alias_dump();
-  // UK_ASSERT(0);
-  uint16_t key = hash_address(alias) % LOOKUP_SIZE;
-  // dprintf("[unregister alias] key = %04X\n", key);
-
-  struct alias *iter;
-  uk_list_for_each_entry(iter, &lookup[key], list)
-    if (iter->alias == alias) {
-      uk_list_del(&iter->list);
-      uk_list_add(&iter->list, &afreelist);
-      return false;
-    }
-
-  return true;
+  dprintf("alias_release(%p)\n", (void *) a->alias);
+  struct alias *entry = (struct alias *)a;
+
+  uk_list_del(&entry->list);
+  alias_clear(entry);
+  uk_list_add(&entry->list, &afreelist);
+  batch_of(entry)->used--;
+  STAT_ALIAS(-1);
 }
 
 /* returns NULL on not found or the alias struct if found */
@@ -122,9 +147,15 @@ const struct alias *alias_search(uintptr_t alias)
   uint16_t key = hash_address(alias) % LOOKUP_SIZE;
 
   struct alias *iter, *s = NULL;
-  uk_list_for_each_entry(iter, &lookup[key], list)
+  size_t probes = 0;
+  uk_list_for_each_entry(iter, &lookup[key], list) {
+    probes++;
     if (iter->alias == alias)
       s = iter;
+  }
+
+  STAT_INC(alias_lookups);
+  STAT_PROBE(probes);
 
   if (s)
     dprintf("Alias found {.alias=%p, .origin=%p, .size=%ld}\n",
@@ -134,3 +165,18 @@ const struct alias *alias_search(uintptr_t alias)
 
   return s;
 }
+
+/* attaches tag to a registered alias */
+void alias_tag(uintptr_t alias, uint32_t tag)
+{
+  uint16_t key = hash_address(alias) % LOOKUP_SIZE;
+
+  struct alias *iter;
+  uk_list_for_each_entry(iter, &lookup[key], list)
+    if (iter->alias == alias) {
+      iter->tag = tag;
+      return;
+    }
+
+  UK_ASSERT(0);
+}
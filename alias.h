@@ -26,8 +26,15 @@ struct alias {
   size_t size;              /* size of the alias in bytes */
   uintptr_t alias;          /* alias start address */
   uintptr_t origin;         /* original addr, used for free() */
+  uint32_t tag;             /* heap profile site, 0 when not sampled */
+  uint8_t flags;            /* ALIAS_ bits below */
 };
 
+/* pages of the alias were given back, see wilde_map_release */
+#define ALIAS_RELEASED (1 << 0)
+/* the memory isn't wilde's, see wilde_map_new_foreign */
+#define ALIAS_FOREIGN (1 << 1)
+
 /* hash table */
 #define LOOKUP_SIZE 0x2000
 extern struct uk_list_head lookup[LOOKUP_SIZE];
@@ -43,7 +50,14 @@ static inline uintptr_t hash_address(uintptr_t x)
 void alias_init(void);
 void alias_dump(void);
 void alias_register(uintptr_t addr, uintptr_t alias, size_t size);
-bool alias_unregister(uintptr_t alias);
 const struct alias *alias_search(uintptr_t alias);
+void alias_release(const struct alias *a);
+void alias_tag(uintptr_t alias, uint32_t tag);
+
+/*
+ * gives the batches of which no alias is registered back to the backing
+ * allocator, returns the pages released
+ */
+size_t alias_shrink(void);
 
 #endif /* __WILDE_ALIAS_H__ */
\ No newline at end of file
@@ -0,0 +1,463 @@
+/*
+ * wilde-bench, standard allocator workloads against whatever allocator the
+ * unikernel was configured with.
+ *
+ * Every workload prints one machine readable line
+ *
+ *   BENCH <workload>,<ops>,<ops/s>,<p50 ns>,<p99 ns>,<p99.9 ns>,<peak bytes>
+ *
+ * between BENCH-BEGIN and BENCH-END, run.sh collects them per configuration.
+ * Unikraft 0.3 has no SMP, so the multi threaded workloads (larson,
+ * xmalloc-test, cache-scratch) run their threads round robin on one core,
+ * which keeps the cross thread free pattern but not the contention.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <uk/alloc.h>
+#include <uk/config.h>
+#include <uk/plat/time.h>
+
+#ifdef CONFIG_LIBWILDE_STATS
+#include <wilde.h>
+#endif
+
+#ifdef CONFIG_APPWILDEBENCH_REPLAY
+#include <replay.h>
+#endif
+
+#define OPS ((uint64_t)CONFIG_APPWILDEBENCH_OPS * 1000)
+
+// helpers {{{
+static inline uint64_t rdtsc(void)
+{
+  uint32_t low, high;
+  __asm__ __volatile__("rdtsc" : "=a"(low), "=d"(high));
+  return ((uint64_t)high << 32) | low;
+}
+
+static uint64_t rng = CONFIG_APPWILDEBENCH_SEED * 0x9e3779b97f4a7c15ULL | 1;
+
+static inline uint64_t rnd(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/* uniform in [lo, hi] */
+static inline size_t rnd_range(size_t lo, size_t hi)
+{
+  return lo + rnd() % (hi - lo + 1);
+}
+
+/* log uniform in [1, max], most allocations are small */
+static inline size_t rnd_size(size_t max)
+{
+  size_t bits = 64 - __builtin_clzl(max);
+  size_t size = rnd() & ((1UL << rnd_range(1, bits)) - 1);
+  return size ? (size > max ? max : size) : 1;
+}
+
+/* touch an object like a program would, first and last byte */
+static inline void touch(void *p, size_t size)
+{
+  ((volatile char *)p)[0] = 1;
+  ((volatile char *)p)[size - 1] = 1;
+}
+// }}}
+
+// measurements {{{
+/*
+ * Log linear latency histogram, 16 buckets per power of 2, so percentiles
+ * are within ~6%
+ */
+#define HIST_SUB 16
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+struct bench {
+  const char *name;
+  uint64_t ops;
+  uint64_t hist[HIST_BUCKETS];
+  ssize_t avail_start;
+  ssize_t avail_min;
+  uint64_t ns_start;
+  uint64_t tsc_start;
+};
+
+static struct bench b;
+
+static inline unsigned hist_index(uint64_t cycles)
+{
+  if (cycles < HIST_SUB)
+    return cycles;
+
+  unsigned n = 63 - __builtin_clzl(cycles);
+  return (n - 3) * HIST_SUB + ((cycles >> (n - 4)) & (HIST_SUB - 1));
+}
+
+static inline uint64_t hist_value(unsigned idx)
+{
+  if (idx < HIST_SUB)
+    return idx;
+
+  unsigned n = idx / HIST_SUB + 3;
+  return (uint64_t)(HIST_SUB + idx % HIST_SUB) << (n - 4);
+}
+
+static uint64_t hist_percentile(unsigned permille)
+{
+  uint64_t total = 0, seen = 0;
+
+  for (unsigned i = 0; i < HIST_BUCKETS; i++)
+    total += b.hist[i];
+
+  uint64_t target = (total * permille + 999) / 1000;
+  for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+    seen += b.hist[i];
+    if (seen >= target && seen)
+      return hist_value(i);
+  }
+
+  return 0;
+}
+
+static inline ssize_t availmem(void)
+{
+  return uk_alloc_availmem(uk_alloc_get_default());
+}
+
+static void bench_begin(const char *name)
+{
+  memset(&b, 0, sizeof(b));
+  b.name = name;
+  b.avail_start = b.avail_min = availmem();
+  b.ns_start = ukplat_monotonic_clock();
+  b.tsc_start = rdtsc();
+}
+
+/* times one allocator call */
+#define TIMED(Expr)                                                            \
+  ({                                                                           \
+    uint64_t __t = rdtsc();                                                    \
+    __typeof__(Expr) __r = (Expr);                                             \
+    b.hist[hist_index(rdtsc() - __t)]++;                                       \
+    b.ops++;                                                                   \
+    if ((b.ops & 255) == 0) {                                                  \
+      ssize_t __a = availmem();                                                \
+      if (__a < b.avail_min)                                                   \
+        b.avail_min = __a;                                                     \
+    }                                                                          \
+    __r;                                                                       \
+  })
+
+#define TIMED_FREE(Ptr) TIMED((free(Ptr), 0))
+
+static void bench_end(void)
+{
+  uint64_t ns = ukplat_monotonic_clock() - b.ns_start;
+  uint64_t tsc = rdtsc() - b.tsc_start;
+
+  /* cycles to ns from the run itself, no TSC frequency needed */
+  uint64_t p50 = hist_percentile(500) * ns / (tsc ? tsc : 1);
+  uint64_t p99 = hist_percentile(990) * ns / (tsc ? tsc : 1);
+  uint64_t p999 = hist_percentile(999) * ns / (tsc ? tsc : 1);
+  uint64_t ops_per_sec = ns ? b.ops * 1000000000ULL / ns : 0;
+
+  printf("BENCH %s,%lu,%lu,%lu,%lu,%lu,%ld\n", b.name, b.ops, ops_per_sec,
+         p50, p99, p999, (long)(b.avail_start - b.avail_min));
+}
+// }}}
+
+// workloads {{{
+/*
+ * larson: every thread owns a set of slots, replaces random ones with new
+ * objects, and at the end of its round hands its set to the next thread, so
+ * most objects are freed by another thread than the one allocating them
+ */
+#define LARSON_THREADS 4
+#define LARSON_SLOTS 1000
+
+static void larson(void)
+{
+  static void *slots[LARSON_THREADS][LARSON_SLOTS];
+  static size_t sizes[LARSON_THREADS][LARSON_SLOTS];
+  uint64_t rounds = OPS / (2 * LARSON_THREADS * LARSON_SLOTS) + 1;
+
+  for (int t = 0; t < LARSON_THREADS; t++)
+    for (int i = 0; i < LARSON_SLOTS; i++) {
+      sizes[t][i] = rnd_range(10, 100);
+      slots[t][i] = malloc(sizes[t][i]);
+    }
+
+  bench_begin("larson");
+  for (uint64_t r = 0; r < rounds; r++) {
+    for (int t = 0; t < LARSON_THREADS; t++)
+      for (int i = 0; i < LARSON_SLOTS; i++) {
+        int victim = rnd() % LARSON_SLOTS;
+        TIMED_FREE(slots[t][victim]);
+        sizes[t][victim] = rnd_range(10, 100);
+        slots[t][victim] = TIMED(malloc(sizes[t][victim]));
+        touch(slots[t][victim], sizes[t][victim]);
+      }
+
+    /* pass the sets on, thread t continues with what t - 1 allocated */
+    void *first[LARSON_SLOTS];
+    size_t first_sizes[LARSON_SLOTS];
+    memcpy(first, slots[0], sizeof(first));
+    memcpy(first_sizes, sizes[0], sizeof(first_sizes));
+    memmove(slots[0], slots[1], sizeof(slots[0]) * (LARSON_THREADS - 1));
+    memmove(sizes[0], sizes[1], sizeof(sizes[0]) * (LARSON_THREADS - 1));
+    memcpy(slots[LARSON_THREADS - 1], first, sizeof(first));
+    memcpy(sizes[LARSON_THREADS - 1], first_sizes, sizeof(first_sizes));
+  }
+  bench_end();
+
+  for (int t = 0; t < LARSON_THREADS; t++)
+    for (int i = 0; i < LARSON_SLOTS; i++)
+      free(slots[t][i]);
+}
+
+/*
+ * xmalloc-test: producers allocate batches which a consumer frees, all
+ * objects die on another thread in allocation order
+ */
+#define XMALLOC_BATCH 4096
+
+static void xmalloc_test(void)
+{
+  static void *batch[XMALLOC_BATCH];
+  uint64_t rounds = OPS / (2 * XMALLOC_BATCH) + 1;
+
+  bench_begin("xmalloc-test");
+  for (uint64_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < XMALLOC_BATCH; i++) {
+      size_t size = rnd_range(1, 128);
+      batch[i] = TIMED(malloc(size));
+      touch(batch[i], size);
+    }
+
+    for (int i = 0; i < XMALLOC_BATCH; i++)
+      TIMED_FREE(batch[i]);
+  }
+  bench_end();
+}
+
+/*
+ * cache-scratch: small objects handed out back to back and written over
+ * and over, under wilde every object gets its own page and TLB entry
+ */
+#define SCRATCH_OBJECTS 64
+#define SCRATCH_WRITES 100
+
+static void cache_scratch(void)
+{
+  void *objs[SCRATCH_OBJECTS];
+  uint64_t rounds = OPS / (2 * SCRATCH_OBJECTS) + 1;
+
+  bench_begin("cache-scratch");
+  for (uint64_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < SCRATCH_OBJECTS; i++)
+      objs[i] = TIMED(malloc(8));
+
+    for (int w = 0; w < SCRATCH_WRITES; w++)
+      for (int i = 0; i < SCRATCH_OBJECTS; i++)
+        ((volatile char *)objs[i])[w & 7]++;
+
+    for (int i = 0; i < SCRATCH_OBJECTS; i++)
+      TIMED_FREE(objs[i]);
+  }
+  bench_end();
+}
+
+/* random-churn: random slots freed or filled with log uniform sizes */
+#define CHURN_SLOTS 4096
+#define CHURN_MAX (64 * 1024)
+
+static void random_churn(void)
+{
+  static void *slots[CHURN_SLOTS];
+
+  bench_begin("random-churn");
+  for (uint64_t op = 0; op < OPS; op++) {
+    int i = rnd() % CHURN_SLOTS;
+
+    if (slots[i]) {
+      TIMED_FREE(slots[i]);
+      slots[i] = NULL;
+    } else {
+      size_t size = rnd_size(CHURN_MAX);
+      slots[i] = TIMED(malloc(size));
+      touch(slots[i], size);
+    }
+  }
+  bench_end();
+
+  for (int i = 0; i < CHURN_SLOTS; i++)
+    free(slots[i]);
+}
+
+/* realloc-growth: buffers growing by 1.5x up to 1MB, like a vector */
+#define GROWTH_MAX (1024 * 1024)
+
+static void realloc_growth(void)
+{
+  bench_begin("realloc-growth");
+  while (b.ops < OPS) {
+    size_t size = 16;
+    char *buf = TIMED(malloc(size));
+
+    while (size < GROWTH_MAX && b.ops < OPS) {
+      size += size / 2;
+      buf = TIMED(realloc(buf, size));
+      touch(buf, size);
+    }
+
+    TIMED_FREE(buf);
+  }
+  bench_end();
+}
+
+/*
+ * fragmentation-soak: mostly short lived objects, every 16th one lives until
+ * the end, peak memory shows how much the survivors pin
+ */
+#define SOAK_LIVE 16
+#define SOAK_KEEP 16
+
+static void fragmentation_soak(void)
+{
+  size_t kept_max = OPS / SOAK_KEEP + 1;
+  void **kept = malloc(kept_max * sizeof(void *));
+  void *live[SOAK_LIVE] = {0};
+  size_t nr_kept = 0;
+
+  bench_begin("fragmentation-soak");
+  for (uint64_t op = 0; b.ops < OPS; op++) {
+    size_t size = rnd_size(4096);
+    void *p = TIMED(malloc(size));
+    touch(p, size);
+
+    if (op % SOAK_KEEP == 0 && nr_kept < kept_max) {
+      kept[nr_kept++] = p;
+      continue;
+    }
+
+    int i = op % SOAK_LIVE;
+    if (live[i])
+      TIMED_FREE(live[i]);
+    live[i] = p;
+  }
+  bench_end();
+
+  for (int i = 0; i < SOAK_LIVE; i++)
+    free(live[i]);
+  for (size_t i = 0; i < nr_kept; i++)
+    free(kept[i]);
+  free(kept);
+}
+
+/*
+ * free-throughput: batches of small objects allocated untimed and freed
+ * timed, so ops and latencies are the frees alone, unmap and TLB
+ * invalidation included
+ */
+#define FREE_BATCH 4096
+
+static void free_throughput(void)
+{
+  static void *batch[FREE_BATCH];
+
+  bench_begin("free-throughput");
+  while (b.ops < OPS) {
+    for (int i = 0; i < FREE_BATCH; i++) {
+      size_t size = rnd_range(16, 256);
+      batch[i] = malloc(size);
+      touch(batch[i], size);
+    }
+
+    for (int i = 0; i < FREE_BATCH; i++)
+      TIMED_FREE(batch[i]);
+  }
+  bench_end();
+}
+
+#ifdef CONFIG_APPWILDEBENCH_REPLAY
+/*
+ * replay: the trace linked in by replay.S, replayed in phases of 256 calls
+ * so peak memory is sampled as often as in the other workloads
+ */
+extern const char replay_start[], replay_end[];
+
+static void replay_phase(const struct replay_phase *p, void *arg)
+{
+  (void)arg;
+
+  /* same log linear layout as ours */
+  for (unsigned i = 0; i < REPLAY_HIST; i++)
+    b.hist[i] += p->hist[i];
+  b.ops += p->ops;
+
+  ssize_t avail = availmem();
+  if (avail < b.avail_min)
+    b.avail_min = avail;
+}
+
+static void replay(void)
+{
+  size_t len = replay_end - replay_start;
+  size_t nr_objs = replay_objects(replay_start, len);
+
+  if (!nr_objs) {
+    printf("replay: %s is not a replay file\n",
+           CONFIG_APPWILDEBENCH_REPLAY_FILE);
+    return;
+  }
+
+  void **objs = calloc(nr_objs, sizeof(*objs));
+  size_t *sizes = calloc(nr_objs, sizeof(*sizes));
+  if (!objs || !sizes) {
+    printf("replay: no memory for %zu objects\n", nr_objs);
+    return;
+  }
+
+  bench_begin("replay");
+  replay_run(uk_alloc_get_default(), replay_start, len, objs, sizes, 256,
+             false, replay_phase, NULL);
+  bench_end();
+
+  /* objects alive at the end of the trace stay, some may be pallocs */
+  free(objs);
+  free(sizes);
+}
+#endif
+// }}}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+
+  printf("BENCH-BEGIN %d %d\n", CONFIG_APPWILDEBENCH_OPS,
+         CONFIG_APPWILDEBENCH_SEED);
+
+  larson();
+  xmalloc_test();
+  cache_scratch();
+  random_churn();
+  realloc_growth();
+  fragmentation_soak();
+  free_throughput();
+#ifdef CONFIG_APPWILDEBENCH_REPLAY
+  replay();
+#endif
+
+#ifdef CONFIG_LIBWILDE_STATS
+  wilde_stats_dump();
+#endif
+
+  printf("BENCH-END\n");
+  return 0;
+}
@@ -0,0 +1,75 @@
+#!/bin/bash
+#
+# Builds and runs wilde-bench for a set of configurations, unattended.
+#
+#   ./run.sh                    all of configs/ (but common)
+#   ./run.sh disable kellogs    only these
+#
+# Every configuration is configs/common.config plus configs/<name>.config.
+# Uses KVM when /dev/kvm is usable, TCG otherwise. Results are appended to
+# results.csv, the full console output of every run lands in logs/.
+#
+# Environment: QEMU (qemu-system-x86_64), MEM (1G), TIMEOUT (seconds, 600)
+set -eu
+
+cd "$(dirname "$0")"
+
+QEMU=${QEMU:-qemu-system-x86_64}
+MEM=${MEM:-1G}
+TIMEOUT=${TIMEOUT:-600}
+KERNEL=build/wilde-bench_kvm-x86_64
+RESULTS=results.csv
+
+if [ -w /dev/kvm ]; then
+  ACCEL="-enable-kvm -cpu host"
+else
+  echo "no usable /dev/kvm, falling back to TCG" >&2
+  ACCEL="-accel tcg -cpu max"
+fi
+
+configs=("$@")
+if [ ${#configs[@]} -eq 0 ]; then
+  for f in configs/*.config; do
+    name=$(basename "$f" .config)
+    [ "$name" = common ] || configs+=("$name")
+  done
+fi
+
+mkdir -p logs
+[ -f "$RESULTS" ] || echo "config,workload,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,peak_bytes" > "$RESULTS"
+
+# boots the kernel, returns once it printed BENCH-END or timed out
+run() {
+  local log=$1
+
+  $QEMU $ACCEL -m "$MEM" -nographic -no-reboot -kernel "$KERNEL" \
+    > "$log" 2>&1 < /dev/null &
+  local pid=$!
+
+  for _ in $(seq "$TIMEOUT"); do
+    if grep -q '^BENCH-END' "$log" || ! kill -0 "$pid" 2> /dev/null; then
+      break
+    fi
+    sleep 1
+  done
+
+  kill "$pid" 2> /dev/null || true
+  wait "$pid" 2> /dev/null || true
+  grep -q '^BENCH-END' "$log"
+}
+
+for cfg in "${configs[@]}"; do
+  echo "== $cfg" >&2
+  cat configs/common.config "configs/$cfg.config" > .config
+  make olddefconfig > /dev/null
+  make -j"$(nproc)" > "logs/$cfg.build.log" 2>&1
+
+  if ! run "logs/$cfg.log"; then
+    echo "$cfg: no BENCH-END, see logs/$cfg.log" >&2
+    continue
+  fi
+
+  tr -d '\r' < "logs/$cfg.log" | sed -n "s/^BENCH \(.*\)/$cfg,\1/p" >> "$RESULTS"
+done
+
+column -s, -t "$RESULTS" >&2 || true
@@ -0,0 +1,142 @@
+#define COLOR COLOR_BLUE
+
+#include <uk/assert.h>
+#include <uk/list.h>
+#include "arena.h"
+#include "wilde_internal.h"
+#include "pagetables.h"
+#include "shimming.h"
+#include "vma.h"
+#include "shootdown.h"
+#include "stats.h"
+#include "util.h"
+#include "x86.h"
+
+#ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
+  #error "Arenas depend on the wilde engine"
+#endif
+
+static UK_LIST_HEAD(arenas);
+
+struct wilde_arena *arena_create(size_t size)
+{
+  dprintf("arena_create(%zu)\n", size);
+  if (!size)
+    return NULL;
+
+  /* reserved ranges never go back to the window, so reserve last */
+  struct wilde_arena *arena = shimmed->malloc(shimmed, sizeof(*arena));
+  if (!arena)
+    return NULL;
+
+  size = ROUNDUP(size, __PAGE_SIZE);
+  uintptr_t start = wilde_map_reserve(size);
+  if (!start) {
+    shimmed->free(shimmed, arena);
+    return NULL;
+  }
+
+  *arena = (struct wilde_arena){.start = start,
+                                .cursor = start,
+                                .mapped = start,
+                                .end = start + size};
+  UK_INIT_LIST_HEAD(&arena->chunks);
+  uk_list_add(&arena->list, &arenas);
+
+  return arena;
+}
+
+/* maps in a chunk of backing memory at arena->mapped holding at least need bytes */
+static bool arena_grow(struct wilde_arena *arena, size_t need)
+{
+  size_t min_order = 0;
+  while ((__PAGE_SIZE << min_order) < need)
+    min_order++;
+
+  /* the last chunk may be smaller, so the whole sub-window can be used */
+  size_t order = MAX(min_order, CONFIG_LIBWILDE_ARENA_CHUNK_ORDER);
+  while (order > min_order && arena->mapped + (__PAGE_SIZE << order) > arena->end)
+    order--;
+
+  size_t size = __PAGE_SIZE << order;
+  if (arena->mapped + size > arena->end)
+    return false;
+
+  void *chunk = shimmed->palloc(shimmed, order);
+  if (!chunk)
+    return false;
+  STAT_ORDER(buddy_orders, order);
+
+  struct vma *v = vma_alloc();
+  v->addr = (uintptr_t)chunk;
+  v->size = size;
+  uk_list_add_tail(&v->list, &arena->chunks);
+
+  remap_range(chunk, (void *)arena->mapped, size);
+  arena->mapped += size;
+
+  return true;
+}
+
+void *arena_alloc(struct wilde_arena *arena, size_t align, size_t size)
+{
+  UK_ASSERT(IS_POWER_2(align));
+  uintptr_t addr = ROUNDUP(arena->cursor, align);
+
+  if (!size || addr < arena->cursor || addr + size < addr ||
+      addr + size > arena->end)
+    return NULL;
+
+  if (addr + size > arena->mapped && !arena_grow(arena, addr + size - arena->mapped))
+    return NULL;
+
+  arena->cursor = addr + size;
+  return (void *)addr;
+}
+
+void arena_destroy(struct wilde_arena *arena)
+{
+  dprintf("arena_destroy(%p) [%#lx-%#lx]\n", arena, arena->start, arena->mapped);
+
+  /* one pass over the page tables and a single flush, not one per page */
+  if (arena->mapped != arena->start) {
+    unmap_range_noflush((void *)arena->start, arena->mapped - arena->start);
+    shootdown_all();
+    shootdown_finish();
+    pt_free_dropped();
+  }
+
+  struct vma *iter, *next;
+  uk_list_for_each_entry_safe(iter, next, &arena->chunks, list) {
+    shimmed->pfree(shimmed, (void *)iter->addr,
+                   LOG2(iter->size) - __PAGE_SHIFT);
+    uk_list_del(&iter->list);
+    vma_free(iter);
+  }
+
+  /* the sub-window itself is never handed out again */
+  uk_list_del(&arena->list);
+  shimmed->free(shimmed, arena);
+}
+
+void arena_verify(struct wilde_verify *v)
+{
+  struct wilde_arena *arena;
+  uk_list_for_each_entry(arena, &arenas, list) {
+    uintptr_t page = arena->start;
+
+    struct vma *chunk;
+    uk_list_for_each_entry(chunk, &arena->chunks, list)
+      for (size_t offset = 0; offset < chunk->size; offset += __PAGE_SIZE) {
+        v->pages++;
+        if (pt_get_phys(page) != chunk->addr + offset)
+          v->bad_pages++;
+        page += __PAGE_SIZE;
+      }
+
+#ifdef CONFIG_LIBWILDE_SHAUN
+    if (pt_get_phys(arena->end))
+      v->bad_guards++;
+#endif
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef __WILDE_ARENA_H__
+#define __WILDE_ARENA_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <uk/list.h>
+#include <wilde.h>
+#include "util.h"
+
+/*
+ * Arenas, for objects that all die together.
+ *
+ * An arena owns a sub-window of the malloc window, reserved at creation and
+ * never handed out again. Objects are bumped out of it, the backing memory
+ * comes in chunks of at least __PAGE_SIZE << CONFIG_LIBWILDE_ARENA_CHUNK_ORDER
+ * bytes mapped in one after the other. Objects share pages, so there is no
+ * alias per object and no overflow detection between them, only behind the
+ * arena under SHAUN.
+ *
+ * Destroying an arena unmaps the mapped part of its sub-window in one pass,
+ * flushes the TLB once and gives the chunks back, whatever the number of
+ * objects. Pointers into it fault like those of any other freed object.
+ */
+
+/* objects are aligned to this by wilde_arena_alloc */
+#define ARENA_ALIGN 16
+
+struct wilde_arena {
+  uintptr_t start;            /* the sub-window */
+  uintptr_t cursor;           /* the next object goes here */
+  uintptr_t mapped;           /* [start, mapped) is mapped in */
+  uintptr_t end;
+  struct uk_list_head chunks; /* struct vma's of the backing memory, in order */
+  struct uk_list_head list;   /* all live arenas */
+};
+
+/* the arena internals, expect the caller to hold the allocator lock */
+struct wilde_arena *arena_create(size_t size);
+void *arena_alloc(struct wilde_arena *arena, size_t align, size_t size);
+void arena_destroy(struct wilde_arena *arena);
+
+/* checks the chunks of every arena against the page tables, see wilde_verify */
+void arena_verify(struct wilde_verify *v);
+
+#endif /* __WILDE_ARENA_H__ */
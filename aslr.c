@@ -0,0 +1,186 @@
+#define COLOR COLOR_CYAN
+
+#include <uk/assert.h>
+#include <uk/print.h>
+#include "aslr.h"
+#include "x86.h"
+#include "util.h"
+
+// generator {{{
+static u64 aslr_state[4];
+static u64 aslr_batch[ASLR_BATCH];
+static unsigned aslr_left;
+
+static inline u64 rotl(u64 x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+/* xoshiro256** */
+static inline u64 aslr_next(void)
+{
+  u64 *s = aslr_state;
+  u64 result = rotl(s[1] * 5, 7) * 9;
+  u64 t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+/* splitmix64, spreads a seed over the state */
+static inline u64 aslr_splitmix(u64 *x)
+{
+  u64 z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static void aslr_seed(void)
+{
+  u64 seed = WILDE_SEED, hw;
+  bool rdrand = rdrand64(&hw);
+
+  if (rdrand)
+    seed ^= hw;
+
+  for (int i = 0; i < 4; i++)
+    aslr_state[i] = aslr_splitmix(&seed);
+
+  uk_pr_info("Seeded the ASLR with %#x%s\n", WILDE_SEED,
+             rdrand ? " and RDRAND" : "");
+}
+
+u64 aslr_rand(void)
+{
+  if (!aslr_left) {
+    /* keep mixing in hardware entropy, one RDRAND per batch */
+    u64 hw;
+    if (rdrand64(&hw))
+      aslr_state[0] ^= hw;
+
+    for (unsigned i = 0; i < ASLR_BATCH; i++)
+      aslr_batch[i] = aslr_next();
+    aslr_left = ASLR_BATCH;
+  }
+
+  return aslr_batch[--aslr_left];
+}
+// }}}
+
+// regions {{{
+#define ASLR_REGIONS CONFIG_LIBWILDE_ASLR_REGIONS
+
+/* less than this left and a region leaves the draw */
+#define ASLR_RETIRE ((CONFIG_LIBWILDE_ASLR_GAP + 2) * __PAGE_SIZE)
+
+struct aslr_region {
+  uintptr_t start;
+  uintptr_t cursor; /* everything from here on is untouched */
+  uintptr_t end;
+};
+
+static struct aslr_region regions[ASLR_REGIONS];
+static u32 active[ASLR_REGIONS]; /* regions still in the draw, shuffled */
+static size_t nr_active;
+static size_t aslr_free; /* what the active regions have left */
+
+void aslr_init(uintptr_t start, size_t size)
+{
+  size_t region_size = ROUNDDOWN(size / ASLR_REGIONS, __PAGE_SIZE);
+  UK_ASSERT(region_size >= 16 * __PAGE_SIZE);
+
+  aslr_seed();
+
+  /* start somewhere in the first sixteenth, so little is lost */
+  for (size_t i = 0; i < ASLR_REGIONS; i++) {
+    struct aslr_region *r = &regions[i];
+    r->start = start + i * region_size;
+    r->end = r->start + region_size;
+    r->cursor = r->start + aslr_below(region_size / 16 / __PAGE_SIZE) * __PAGE_SIZE;
+    active[i] = i;
+    aslr_free += r->end - r->cursor;
+  }
+
+  /* Fisher-Yates, the order the full scan goes through them in */
+  for (size_t i = ASLR_REGIONS - 1; i > 0; i--) {
+    size_t j = aslr_below(i + 1);
+    u32 tmp = active[i];
+    active[i] = active[j];
+    active[j] = tmp;
+  }
+
+  nr_active = ASLR_REGIONS;
+  dprintf("ASLR over %d regions of %#lx bytes\n", ASLR_REGIONS, region_size);
+}
+
+/* takes size bytes out of the i'th active region, or 0 if they don't fit */
+static uintptr_t aslr_take(size_t i, size_t size, size_t alignment)
+{
+  struct aslr_region *r = &regions[active[i]];
+  uintptr_t gap = aslr_below(CONFIG_LIBWILDE_ASLR_GAP + 1) * __PAGE_SIZE;
+  uintptr_t aligned = ROUNDUP(r->cursor + gap, alignment);
+
+  if (aligned < r->end && r->end - aligned >= size) {
+    aslr_free -= aligned + size - r->cursor;
+    r->cursor = aligned + size;
+  } else {
+    aligned = 0;
+  }
+
+  /* out of the draw, swapped with the last one */
+  if (r->end - r->cursor < ASLR_RETIRE) {
+    aslr_free -= r->end - r->cursor;
+    active[i] = active[--nr_active];
+  }
+
+  return aligned;
+}
+
+uintptr_t aslr_reserve(size_t size, size_t alignment)
+{
+  for (int i = 0; i < ASLR_TRIES && nr_active; i++) {
+    uintptr_t addr = aslr_take(aslr_below(nr_active), size, alignment);
+    if (addr)
+      return addr;
+  }
+
+  /*
+   * large requests and a nearly full window, backwards as retiring swaps in
+   * a region we already went through
+   */
+  for (size_t i = nr_active; i-- > 0;) {
+    uintptr_t addr = aslr_take(i, size, alignment);
+    if (addr)
+      return addr;
+  }
+
+  return 0;
+}
+
+size_t aslr_remaining(void)
+{
+  return aslr_free;
+}
+
+size_t aslr_verify(void)
+{
+  size_t bad = 0, remaining = 0;
+
+  for (size_t i = 0; i < ASLR_REGIONS; i++)
+    if (regions[i].cursor < regions[i].start ||
+        regions[i].cursor > regions[i].end)
+      bad++;
+
+  for (size_t i = 0; i < nr_active; i++)
+    remaining += regions[active[i]].end - regions[active[i]].cursor;
+
+  return bad + (remaining != aslr_free);
+}
+// }}}
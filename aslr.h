@@ -0,0 +1,55 @@
+#ifndef __WILDE_ASLR_H__
+#define __WILDE_ASLR_H__
+#include <stdint.h>
+#include <stddef.h>
+#include "util.h"
+
+/*
+ * ASLR for the alias window.
+ *
+ * The malloc window is cut into CONFIG_LIBWILDE_ASLR_REGIONS regions, each a
+ * bump allocator starting at a random offset into it. Every reservation draws
+ * a region and leaves a random gap of up to CONFIG_LIBWILDE_ASLR_GAP pages in
+ * front of itself, so aliases land all over the window. A region that can't
+ * fit a request is skipped, one that has run out leaves the draw, so a
+ * reservation stays O(1) until the window is nearly used up. The palloc
+ * window gets the same from vbuddy splitting its blocks in random halves.
+ *
+ * Random numbers come from xoshiro256**, seeded with WILDE_SEED and RDRAND
+ * when the CPU has it, and are generated a batch at a time.
+ */
+
+/* reservations try this many random regions before going through all */
+#define ASLR_TRIES 4
+
+/* random numbers generated at once */
+#define ASLR_BATCH 64
+
+/* seeds the generator and sets up the regions of [start, start + size) */
+void aslr_init(uintptr_t start, size_t size);
+
+/*
+ * @success: returns the start of size bytes aligned to alignment
+ * @fail:    returns 0 when no region fits them anymore
+ */
+uintptr_t aslr_reserve(size_t size, size_t alignment);
+
+/* bytes the regions have left, gaps included, kept as they're taken */
+size_t aslr_remaining(void);
+
+/*
+ * regions whose cursor left their bounds, plus one when the bytes they have
+ * left don't add up to aslr_remaining(), for wilde_verify
+ */
+size_t aslr_verify(void);
+
+/* the next random number */
+u64 aslr_rand(void);
+
+/* uniform in [0, n), a multiply instead of a modulo */
+static inline u64 aslr_below(u64 n)
+{
+  return ((__uint128_t)aslr_rand() * n) >> 64;
+}
+
+#endif /* __WILDE_ASLR_H__ */
@@ -0,0 +1,31 @@
+#ifndef __WILDE_BATCH_H__
+#define __WILDE_BATCH_H__
+#include <stddef.h>
+#include <stdint.h>
+#include <uk/list.h>
+#include "util.h"
+
+/*
+ * Metadata structs, vmas and aliases, come in batches of BATCH_SIZE bytes
+ * taken with palloc, which hands out blocks aligned to their size. A header
+ * at the start of every batch counts the structs in use, the batch of a
+ * struct is found by rounding its address down, and a batch none are used of
+ * can go back to the backing allocator under memory pressure.
+ */
+#define BATCH_ORDER 1
+#define BATCH_SIZE (__PAGE_SIZE << BATCH_ORDER)
+
+struct batch {
+  struct uk_list_head list; /* all batches of one kind of struct */
+  size_t used;              /* structs handed out */
+};
+
+#define BATCH_ENTRIES(Type) ((BATCH_SIZE - sizeof(struct batch)) / sizeof(Type))
+#define BATCH_FIRST(Batch, Type) ((Type *)((struct batch *)(Batch) + 1))
+
+static inline struct batch *batch_of(const void *obj)
+{
+  return (struct batch *)ROUNDDOWN((uintptr_t)obj, BATCH_SIZE);
+}
+
+#endif /* __WILDE_BATCH_H__ */
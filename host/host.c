@@ -0,0 +1,303 @@
+#define COLOR COLOR_WHITE
+
+/*
+ * Host side of the host build: a mock buddy allocator standing in for
+ * ukallocbbuddy, the simulated CPU state x86.h reads and writes, and the bits
+ * of the Unikraft platform wilde calls into.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <uk/alloc.h>
+#include <uk/allocbbuddy.h>
+#include <uk/assert.h>
+#include "wilde_host.h"
+#include "../util.h"
+#include "../x86.h"
+
+/* simulated CPU */
+uintptr_t host_cr3;
+uintptr_t host_cr4;
+u64 host_efer;
+u64 host_cr3_writes;
+u64 host_invlpgs;
+unsigned host_cpu; /* id plus one, 0 until wilde_smp_cpu_online() */
+
+/* simulated physical memory */
+uintptr_t host_phys_start;
+uintptr_t host_phys_end;
+
+// mock buddy {{{
+/*
+ * Binary buddy allocator over the pool, coalescing on free. Free blocks keep
+ * their list links in their first bytes, block_order remembers the order of
+ * every free block by its first page so a buddy can be checked in O(1).
+ */
+#define BUDDY_ORDERS 32
+#define BUDDY_NOT_FREE 0xff
+
+struct buddy_block {
+  struct buddy_block *next, *prev;
+};
+
+static struct buddy_block buddy_free[BUDDY_ORDERS];
+static u8 *block_order;
+static size_t buddy_pages_free;
+
+/* the header of uk_malloc_ifpages style allocations */
+struct buddy_meta {
+  void *base;
+  size_t order;
+};
+
+static inline size_t page_index(void *p)
+{
+  return ((uintptr_t)p - host_phys_start) / __PAGE_SIZE;
+}
+
+static void buddy_push(struct buddy_block *b, size_t order)
+{
+  struct buddy_block *head = &buddy_free[order];
+
+  b->next = head->next;
+  b->prev = head;
+  head->next->prev = b;
+  head->next = b;
+  block_order[page_index(b)] = order;
+}
+
+static void buddy_unlink(struct buddy_block *b)
+{
+  b->prev->next = b->next;
+  b->next->prev = b->prev;
+  block_order[page_index(b)] = BUDDY_NOT_FREE;
+}
+
+static void *buddy_palloc(struct uk_alloc *a, size_t order)
+{
+  UNUSED(a);
+  size_t o = order;
+
+  while (o < BUDDY_ORDERS && buddy_free[o].next == &buddy_free[o])
+    o++;
+  if (o >= BUDDY_ORDERS)
+    return NULL;
+
+  struct buddy_block *b = buddy_free[o].next;
+  buddy_unlink(b);
+
+  /* give back the upper halves until we're at the right order */
+  while (o > order) {
+    o--;
+    buddy_push((struct buddy_block *)((uintptr_t)b + (__PAGE_SIZE << o)), o);
+  }
+
+  buddy_pages_free -= 1UL << order;
+  return b;
+}
+
+static void buddy_pfree(struct uk_alloc *a, void *ptr, size_t order)
+{
+  UNUSED(a);
+  uintptr_t p = (uintptr_t)ptr;
+
+  UK_ASSERT(p >= host_phys_start && p < host_phys_end);
+  buddy_pages_free += 1UL << order;
+
+  while (order + 1 < BUDDY_ORDERS) {
+    uintptr_t buddy = p ^ (__PAGE_SIZE << order);
+    if (buddy < host_phys_start || buddy + (__PAGE_SIZE << order) > host_phys_end ||
+        block_order[page_index((void *)buddy)] != order)
+      break;
+
+    buddy_unlink((struct buddy_block *)buddy);
+    p = MIN(p, buddy);
+    order++;
+  }
+
+  buddy_push((struct buddy_block *)p, order);
+}
+
+static size_t buddy_order(size_t bytes)
+{
+  size_t pages = ROUNDUP(bytes, __PAGE_SIZE) / __PAGE_SIZE;
+  return pages > 1 ? LOG2(pages - 1) + 1 : 0;
+}
+
+static void *buddy_memalign(struct uk_alloc *a, size_t align, size_t size)
+{
+  if (align < sizeof(struct buddy_meta))
+    align = sizeof(struct buddy_meta);
+
+  size_t order = buddy_order(size + align);
+  void *base = buddy_palloc(a, order);
+  if (!base)
+    return NULL;
+
+  struct buddy_meta *meta =
+    (struct buddy_meta *)ROUNDUP((uintptr_t)base + sizeof(*meta), align) - 1;
+  *meta = (struct buddy_meta){.base = base, .order = order};
+  return meta + 1;
+}
+
+static void *buddy_malloc(struct uk_alloc *a, size_t size)
+{
+  return buddy_memalign(a, sizeof(struct buddy_meta), size);
+}
+
+static void *buddy_calloc(struct uk_alloc *a, size_t nmemb, size_t size)
+{
+  void *p = buddy_malloc(a, nmemb * size);
+  if (p)
+    memset(p, 0, nmemb * size);
+  return p;
+}
+
+static void buddy_free_obj(struct uk_alloc *a, void *ptr)
+{
+  if (!ptr)
+    return;
+
+  struct buddy_meta *meta = (struct buddy_meta *)ptr - 1;
+  buddy_pfree(a, meta->base, meta->order);
+}
+
+static void *buddy_realloc(struct uk_alloc *a, void *ptr, size_t size)
+{
+  if (!ptr)
+    return buddy_malloc(a, size);
+
+  struct buddy_meta *meta = (struct buddy_meta *)ptr - 1;
+  size_t old = (__PAGE_SIZE << meta->order) - ((uintptr_t)ptr - (uintptr_t)meta->base);
+
+  void *p = buddy_malloc(a, size);
+  if (p) {
+    memcpy(p, ptr, MIN(old, size));
+    buddy_free_obj(a, ptr);
+  }
+  return p;
+}
+
+static int buddy_posix_memalign(struct uk_alloc *a, void **memptr,
+                                size_t align, size_t size)
+{
+  *memptr = buddy_memalign(a, align, size);
+  return *memptr ? 0 : ENOMEM;
+}
+
+static ssize_t buddy_availmem(struct uk_alloc *a)
+{
+  UNUSED(a);
+  return buddy_pages_free * __PAGE_SIZE;
+}
+
+static int buddy_addmem(struct uk_alloc *a, void *base, size_t size)
+{
+  UNUSED(a);
+  UNUSED(base);
+  UNUSED(size);
+  return -ENOTSUP;
+}
+
+static struct uk_alloc buddy = {
+  .malloc = buddy_malloc,
+  .calloc = buddy_calloc,
+  .realloc = buddy_realloc,
+  .posix_memalign = buddy_posix_memalign,
+  .memalign = buddy_memalign,
+  .free = buddy_free_obj,
+  .palloc = buddy_palloc,
+  .pfree = buddy_pfree,
+  .availmem = buddy_availmem,
+  .addmem = buddy_addmem,
+};
+
+struct uk_alloc *uk_allocbbuddy_init(void *base, size_t len)
+{
+  host_phys_start = ROUNDUP((uintptr_t)base, __PAGE_SIZE);
+  host_phys_end = ROUNDDOWN((uintptr_t)base + len, __PAGE_SIZE);
+
+  size_t pages = (host_phys_end - host_phys_start) / __PAGE_SIZE;
+  block_order = malloc(pages);
+  if (!block_order)
+    return NULL;
+  memset(block_order, BUDDY_NOT_FREE, pages);
+
+  for (int o = 0; o < BUDDY_ORDERS; o++)
+    buddy_free[o].next = buddy_free[o].prev = &buddy_free[o];
+
+  /*
+   * carve the pool into the largest naturally aligned blocks, aligned by
+   * address like physical memory, kallocs_free relies on it
+   */
+  uintptr_t p = host_phys_start;
+  while (p < host_phys_end) {
+    size_t order = BUDDY_ORDERS - 1;
+    while (((p & ((__PAGE_SIZE << order) - 1)) ||
+            p + (__PAGE_SIZE << order) > host_phys_end))
+      order--;
+
+    buddy_pfree(&buddy, (void *)p, order);
+    p += __PAGE_SIZE << order;
+  }
+
+  return &buddy;
+}
+// }}}
+
+// platform {{{
+static struct uk_alloc *default_alloc;
+
+struct uk_alloc *uk_alloc_get_default(void)
+{
+  return default_alloc;
+}
+
+int uk_alloc_set_default(struct uk_alloc *a)
+{
+  default_alloc = a;
+  return 0;
+}
+
+int ukplat_coutk(const char *buf, unsigned int len)
+{
+  return write(STDERR_FILENO, buf, len);
+}
+
+void ukplat_crash(void)
+{
+  abort();
+}
+// }}}
+
+extern void (*uk_ctor_wilde_init)(void);
+
+struct uk_alloc *wilde_host_init(size_t pool_size)
+{
+  void *pool = mmap(NULL, pool_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (pool == MAP_FAILED)
+    return NULL;
+
+  if (!uk_allocbbuddy_init(pool, pool_size))
+    return NULL;
+  uk_alloc_set_default(&buddy);
+
+  /* the boot page tables, an empty top level */
+  host_cr3 = (uintptr_t)buddy_palloc(&buddy, 0);
+  if (!host_cr3)
+    return NULL;
+  memset((void *)host_cr3, 0, __PAGE_SIZE);
+
+  uk_ctor_wilde_init();
+  return uk_alloc_get_default();
+}
+
+void wilde_host_counters(struct wilde_host_counters *out)
+{
+  out->cr3_writes = host_cr3_writes;
+  out->invlpgs = host_invlpgs;
+  out->pool_free = buddy_pages_free * __PAGE_SIZE;
+}
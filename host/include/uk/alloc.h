@@ -0,0 +1,68 @@
+#ifndef __WILDE_HOST_UK_ALLOC_H__
+#define __WILDE_HOST_UK_ALLOC_H__
+#include <stddef.h>
+#include <sys/types.h>
+#include <uk/assert.h>
+
+/* the Unikraft 0.3 allocator interface */
+struct uk_alloc {
+  void *(*malloc)(struct uk_alloc *a, size_t size);
+  void *(*calloc)(struct uk_alloc *a, size_t nmemb, size_t size);
+  void *(*realloc)(struct uk_alloc *a, void *ptr, size_t size);
+  int (*posix_memalign)(struct uk_alloc *a, void **memptr, size_t align,
+                        size_t size);
+  void *(*memalign)(struct uk_alloc *a, size_t align, size_t size);
+  void (*free)(struct uk_alloc *a, void *ptr);
+  void *(*palloc)(struct uk_alloc *a, size_t order);
+  void (*pfree)(struct uk_alloc *a, void *ptr, size_t order);
+  ssize_t (*availmem)(struct uk_alloc *a);
+  int (*addmem)(struct uk_alloc *a, void *base, size_t size);
+  struct uk_alloc *next;
+  char priv[];
+};
+
+struct uk_alloc *uk_alloc_get_default(void);
+int uk_alloc_set_default(struct uk_alloc *a);
+
+static inline void *uk_malloc(struct uk_alloc *a, size_t size)
+{
+  return a->malloc(a, size);
+}
+
+static inline void *uk_calloc(struct uk_alloc *a, size_t nmemb, size_t size)
+{
+  return a->calloc(a, nmemb, size);
+}
+
+static inline void *uk_realloc(struct uk_alloc *a, void *ptr, size_t size)
+{
+  return a->realloc(a, ptr, size);
+}
+
+static inline int uk_posix_memalign(struct uk_alloc *a, void **memptr,
+                                    size_t align, size_t size)
+{
+  return a->posix_memalign(a, memptr, align, size);
+}
+
+static inline void *uk_memalign(struct uk_alloc *a, size_t align, size_t size)
+{
+  return a->memalign(a, align, size);
+}
+
+static inline void uk_free(struct uk_alloc *a, void *ptr)
+{
+  a->free(a, ptr);
+}
+
+static inline void *uk_palloc(struct uk_alloc *a, size_t order)
+{
+  return a->palloc(a, order);
+}
+
+static inline void uk_pfree(struct uk_alloc *a, void *ptr, size_t order)
+{
+  a->pfree(a, ptr, order);
+}
+
+#endif /* __WILDE_HOST_UK_ALLOC_H__ */
@@ -0,0 +1,8 @@
+#ifndef __WILDE_HOST_UK_ALLOCBBUDDY_H__
+#define __WILDE_HOST_UK_ALLOCBBUDDY_H__
+#include <uk/alloc.h>
+
+/* the mock buddy allocator of host/host.c */
+struct uk_alloc *uk_allocbbuddy_init(void *base, size_t len);
+
+#endif /* __WILDE_HOST_UK_ALLOCBBUDDY_H__ */
@@ -0,0 +1,10 @@
+#ifndef __WILDE_HOST_UK_ARCH_LIMITS_H__
+#define __WILDE_HOST_UK_ARCH_LIMITS_H__
+
+#define __PAGE_SHIFT 12
+#define __PAGE_SIZE (1UL << __PAGE_SHIFT)
+
+/* the main thread's, Linux's default stack limit */
+#define __STACK_SIZE (8UL << 20)
+
+#endif /* __WILDE_HOST_UK_ARCH_LIMITS_H__ */
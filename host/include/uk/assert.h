@@ -0,0 +1,23 @@
+#ifndef __WILDE_HOST_UK_ASSERT_H__
+#define __WILDE_HOST_UK_ASSERT_H__
+#include <uk/print.h>
+
+void __attribute__((noreturn)) ukplat_crash(void);
+
+#define UK_ASSERT(x)                                                           \
+  do {                                                                         \
+    if (!(x)) {                                                                \
+      uk_pr_crit("Assertion failure: %s (%s:%d)\n", #x, __FILE__, __LINE__);   \
+      ukplat_crash();                                                          \
+    }                                                                          \
+  } while (0)
+
+#define UK_BUGON(x) UK_ASSERT(!(x))
+
+#define UK_CRASH(...)                                                          \
+  do {                                                                         \
+    uk_pr_crit(__VA_ARGS__);                                                   \
+    ukplat_crash();                                                            \
+  } while (0)
+
+#endif /* __WILDE_HOST_UK_ASSERT_H__ */
@@ -0,0 +1,94 @@
+#ifndef __WILDE_HOST_UK_CONFIG_H__
+#define __WILDE_HOST_UK_CONFIG_H__
+
+/*
+ * Host build configuration, the rest comes from HOST_CONFIG in host/Makefile
+ * as -DCONFIG_... flags. Values Config.uk would default are defaulted here.
+ */
+#define CONFIG_ARCH_X86_64 1
+#define CONFIG_PLAT_KVM 1
+#define CONFIG_LIBUKALLOC_IFPAGES 1
+#define CONFIG_LIBUKALLOC_IFSTATS 1
+#define CONFIG_LIBWILDE 1
+
+#ifdef CONFIG_LIBWILDE_INIT_MEMORY
+#error "aliases aren't mapped on the host, LIBWILDE_INIT_MEMORY can't work"
+#endif
+
+#ifndef CONFIG_LIBWILDE_INIT_MEMORY_VALUE
+#define CONFIG_LIBWILDE_INIT_MEMORY_VALUE 0
+#endif
+
+#ifndef CONFIG_LIBWILDE_SAMPLING_RATE
+#define CONFIG_LIBWILDE_SAMPLING_RATE 100
+#endif
+
+#ifndef CONFIG_LIBWILDE_POLICY_RULES
+#define CONFIG_LIBWILDE_POLICY_RULES ""
+#endif
+
+#ifndef CONFIG_LIBWILDE_CALLER_DEPTH
+#define CONFIG_LIBWILDE_CALLER_DEPTH 1
+#endif
+
+#ifndef CONFIG_LIBWILDE_TRACE_ENTRIES
+#define CONFIG_LIBWILDE_TRACE_ENTRIES 4096
+#endif
+
+#ifndef CONFIG_LIBWILDE_NR_CPUS
+#define CONFIG_LIBWILDE_NR_CPUS 8
+#endif
+
+#ifndef CONFIG_LIBWILDE_SHOOTDOWN_BATCH
+#define CONFIG_LIBWILDE_SHOOTDOWN_BATCH 32
+#endif
+
+#ifndef CONFIG_LIBWILDE_ASLR_REGIONS
+#define CONFIG_LIBWILDE_ASLR_REGIONS 64
+#endif
+
+#ifndef CONFIG_LIBWILDE_ASLR_GAP
+#define CONFIG_LIBWILDE_ASLR_GAP 15
+#endif
+
+#ifndef CONFIG_LIBWILDE_CACHE_MAGAZINE
+#define CONFIG_LIBWILDE_CACHE_MAGAZINE 16
+#endif
+
+#ifndef CONFIG_LIBWILDE_MAGAZINE_HOT
+#define CONFIG_LIBWILDE_MAGAZINE_HOT 4
+#endif
+
+#ifndef CONFIG_LIBWILDE_MAGAZINE_DEPTH
+#define CONFIG_LIBWILDE_MAGAZINE_DEPTH 32
+#endif
+
+#ifndef CONFIG_LIBWILDE_MAGAZINE_INTERVAL
+#define CONFIG_LIBWILDE_MAGAZINE_INTERVAL 1000
+#endif
+
+#ifndef CONFIG_LIBWILDE_RECLAIM_THRESHOLD
+#define CONFIG_LIBWILDE_RECLAIM_THRESHOLD 16
+#endif
+
+#ifndef CONFIG_LIBWILDE_RECLAIM_BUDGET
+#define CONFIG_LIBWILDE_RECLAIM_BUDGET 20000
+#endif
+
+#ifndef CONFIG_LIBWILDE_PRESSURE_LOW
+#define CONFIG_LIBWILDE_PRESSURE_LOW 4
+#endif
+
+#ifndef CONFIG_LIBWILDE_ARENA_CHUNK_ORDER
+#define CONFIG_LIBWILDE_ARENA_CHUNK_ORDER 4
+#endif
+
+#ifndef CONFIG_LIBWILDE_PROFILE_INTERVAL
+#define CONFIG_LIBWILDE_PROFILE_INTERVAL 524288
+#endif
+
+#ifndef CONFIG_LIBWILDE_PROFILE_DEPTH
+#define CONFIG_LIBWILDE_PROFILE_DEPTH 8
+#endif
+
+#endif /* __WILDE_HOST_UK_CONFIG_H__ */
@@ -0,0 +1,7 @@
+#ifndef __WILDE_HOST_UK_CTORS_H__
+#define __WILDE_HOST_UK_CTORS_H__
+
+/* no boot sequence on the host, wilde_host_init() calls the constructor */
+#define UK_CTOR_FUNC(lvl, fn) void (*uk_ctor_##fn)(void) = fn;
+
+#endif /* __WILDE_HOST_UK_CTORS_H__ */
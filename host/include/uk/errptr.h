@@ -0,0 +1,3 @@
+#ifndef __WILDE_HOST_UK_ERRPTR_H__
+#define __WILDE_HOST_UK_ERRPTR_H__
+#endif /* __WILDE_HOST_UK_ERRPTR_H__ */
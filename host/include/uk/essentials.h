@@ -0,0 +1,14 @@
+#ifndef __WILDE_HOST_UK_ESSENTIALS_H__
+#define __WILDE_HOST_UK_ESSENTIALS_H__
+
+#define __unused __attribute__((unused))
+#define __noreturn __attribute__((noreturn))
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#endif /* __WILDE_HOST_UK_ESSENTIALS_H__ */
@@ -0,0 +1,78 @@
+#ifndef __WILDE_HOST_UK_LIST_H__
+#define __WILDE_HOST_UK_LIST_H__
+#include <stddef.h>
+
+/* the subset of the Unikraft (Linux style) list API wilde uses */
+struct uk_list_head {
+  struct uk_list_head *next, *prev;
+};
+
+#define UK_LIST_HEAD_INIT(name) { &(name), &(name) }
+#define UK_LIST_HEAD(name) struct uk_list_head name = UK_LIST_HEAD_INIT(name)
+
+static inline void UK_INIT_LIST_HEAD(struct uk_list_head *list)
+{
+  list->next = list;
+  list->prev = list;
+}
+
+static inline void __uk_list_add(struct uk_list_head *entry,
+                                 struct uk_list_head *prev,
+                                 struct uk_list_head *next)
+{
+  next->prev = entry;
+  entry->next = next;
+  entry->prev = prev;
+  prev->next = entry;
+}
+
+static inline void uk_list_add(struct uk_list_head *entry,
+                               struct uk_list_head *head)
+{
+  __uk_list_add(entry, head, head->next);
+}
+
+static inline void uk_list_add_tail(struct uk_list_head *entry,
+                                    struct uk_list_head *head)
+{
+  __uk_list_add(entry, head->prev, head);
+}
+
+static inline void uk_list_del(struct uk_list_head *entry)
+{
+  entry->next->prev = entry->prev;
+  entry->prev->next = entry->next;
+}
+
+static inline void uk_list_del_init(struct uk_list_head *entry)
+{
+  uk_list_del(entry);
+  UK_INIT_LIST_HEAD(entry);
+}
+
+static inline int uk_list_empty(const struct uk_list_head *head)
+{
+  return head->next == head;
+}
+
+#define uk_list_entry(ptr, type, member)                                       \
+  ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define uk_list_first_entry(ptr, type, member)                                 \
+  uk_list_entry((ptr)->next, type, member)
+
+#define uk_list_last_entry(ptr, type, member)                                  \
+  uk_list_entry((ptr)->prev, type, member)
+
+#define uk_list_for_each_entry(pos, head, member)                              \
+  for (pos = uk_list_entry((head)->next, __typeof__(*pos), member);            \
+       &pos->member != (head);                                                 \
+       pos = uk_list_entry(pos->member.next, __typeof__(*pos), member))
+
+#define uk_list_for_each_entry_safe(pos, n, head, member)                      \
+  for (pos = uk_list_entry((head)->next, __typeof__(*pos), member),            \
+      n = uk_list_entry(pos->member.next, __typeof__(*pos), member);           \
+       &pos->member != (head);                                                 \
+       pos = n, n = uk_list_entry(n->member.next, __typeof__(*n), member))
+
+#endif /* __WILDE_HOST_UK_LIST_H__ */
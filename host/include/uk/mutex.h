@@ -0,0 +1,21 @@
+#ifndef __WILDE_HOST_UK_MUTEX_H__
+#define __WILDE_HOST_UK_MUTEX_H__
+#include <pthread.h>
+
+struct uk_mutex {
+  pthread_mutex_t lock;
+};
+
+#define UK_MUTEX_INITIALIZER(name) { PTHREAD_MUTEX_INITIALIZER }
+
+static inline void uk_mutex_lock(struct uk_mutex *m)
+{
+  pthread_mutex_lock(&m->lock);
+}
+
+static inline void uk_mutex_unlock(struct uk_mutex *m)
+{
+  pthread_mutex_unlock(&m->lock);
+}
+
+#endif /* __WILDE_HOST_UK_MUTEX_H__ */
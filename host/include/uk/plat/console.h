@@ -0,0 +1,8 @@
+#ifndef __WILDE_HOST_UK_PLAT_CONSOLE_H__
+#define __WILDE_HOST_UK_PLAT_CONSOLE_H__
+#include <errno.h>
+
+/* writes to stderr */
+int ukplat_coutk(const char *buf, unsigned int len);
+
+#endif /* __WILDE_HOST_UK_PLAT_CONSOLE_H__ */
@@ -0,0 +1,12 @@
+#ifndef __WILDE_HOST_UK_PRINT_H__
+#define __WILDE_HOST_UK_PRINT_H__
+#include <stdio.h>
+
+/* kernel messages go to stderr, debug ones are dropped */
+#define uk_pr_crit(...) fprintf(stderr, __VA_ARGS__)
+#define uk_pr_err(...) fprintf(stderr, __VA_ARGS__)
+#define uk_pr_warn(...) fprintf(stderr, __VA_ARGS__)
+#define uk_pr_info(...) do { if (0) fprintf(stderr, __VA_ARGS__); } while (0)
+#define uk_pr_debug(...) do { if (0) fprintf(stderr, __VA_ARGS__); } while (0)
+
+#endif /* __WILDE_HOST_UK_PRINT_H__ */
@@ -0,0 +1,26 @@
+#ifndef __WILDE_HOST_UK_SCHED_H__
+#define __WILDE_HOST_UK_SCHED_H__
+#include <stdint.h>
+
+/*
+ * No scheduler on the host, background work is driven by hand, e.g. through
+ * wilde_magazine_refill()
+ */
+struct uk_thread;
+
+static inline struct uk_thread *uk_thread_create(const char *name,
+                                                 void (*function)(void *),
+                                                 void *arg)
+{
+  (void)name;
+  (void)function;
+  (void)arg;
+  return NULL;
+}
+
+static inline void uk_sched_thread_sleep(uint64_t nsec)
+{
+  (void)nsec;
+}
+
+#endif /* __WILDE_HOST_UK_SCHED_H__ */
@@ -0,0 +1,30 @@
+#ifndef __WILDE_HOST_H__
+#define __WILDE_HOST_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <uk/alloc.h>
+
+/*
+ * Host build of wilde, the same allocator code on a Linux process.
+ *
+ * Physical memory is an mmap'ed pool handed to a mock buddy allocator, the
+ * page tables wilde builds live in that pool but are never loaded, so aliases
+ * can't be dereferenced. Use wilde_map_get() to reach an allocation's memory.
+ */
+
+/*
+ * sets up pool_size bytes of simulated physical memory and runs the wilde
+ * constructor on it, returns the shim allocator or NULL
+ */
+struct uk_alloc *wilde_host_init(size_t pool_size);
+
+/* simulated hardware counters */
+struct wilde_host_counters {
+  uint64_t cr3_writes;  /* full TLB flushes */
+  uint64_t invlpgs;     /* single page flushes */
+  uint64_t pool_free;   /* bytes left in the mock buddy allocator */
+};
+
+void wilde_host_counters(struct wilde_host_counters *out);
+
+#endif /* __WILDE_HOST_H__ */
@@ -5,6 +5,7 @@
 #include <uk/alloc.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <wilde_trace.h>
 
 /* if ARCH != X64 */
 #ifndef CONFIG_ARCH_X86_64
@@ -25,11 +26,420 @@ extern "C" {
 
 void print_pgtables(bool skip_first_gb);
 
+/* p4 tables with fewer present entries than this count as sparse */
+#define WILDE_PT_SPARSE 8
+
+/* levels are indexed 0 (cr3, p1) to 3 (p4) */
+struct wilde_pt_census {
+  uint64_t tables[4];      /* page tables per level */
+  uint64_t present[4];     /* present entries per level */
+  uint64_t pages_4k;       /* mappings per page size */
+  uint64_t pages_2m;
+  uint64_t pages_1g;
+  uint64_t sparse_p4;      /* p4 tables below WILDE_PT_SPARSE entries */
+  uint64_t window_tables;  /* tables below p1 that only map the alias window */
+  uint64_t window_bytes;   /* the memory those take */
+};
+
+/* counts the page tables, without printing or allocating anything */
+void wilde_pt_census(struct wilde_pt_census *out);
+
+/*
+ * the bytes usable at ptr, at least the size asked for and up to the end of
+ * its last page, which can be much more. 0 for NULL and for pointers wilde
+ * didn't alias.
+ *
+ * Both this and wilde_free_sized() only know about aliases. Allocations
+ * sampling or the policy passed through, and everything under
+ * LIBWILDE_DISABLE_INJECTION, are the backing allocator's, which can't tell
+ * their size. Free those with free().
+ */
+size_t wilde_usable_size(const void *ptr);
+
+/*
+ * frees the alias ptr for callers knowing its size, anything from the size
+ * asked for up to wilde_usable_size(ptr). A size outside of that, or a ptr
+ * that isn't an alias, is an invalid free.
+ */
+void wilde_free_sized(void *ptr, size_t size);
+
+/* what wilde_verify found, every bad_ count should be 0 */
+struct wilde_verify {
+  uint64_t aliases;      /* aliases in the lookup table */
+  uint64_t pages;        /* alias window pages they and arenas should map */
+  uint64_t mapped;       /* alias window pages actually mapped */
+  uint64_t free_vmas;    /* entries of the malloc window free list */
+  uint64_t bad_aliases;  /* outside the window, or at another page offset */
+  uint64_t bad_pages;    /* alias pages unmapped or mapped elsewhere */
+  uint64_t bad_guards;   /* SHAUN guard pages that are mapped */
+  uint64_t bad_vmas;     /* free list entries unordered, overlapping or out of the window */
+};
+
+/*
+ * checks every alias against a page table walk, the number of mapped pages in
+ * the alias window against the aliases and the free list of the malloc window.
+ * Takes the allocator lock, and time linear in the live aliases.
+ *
+ * returns whether everything was consistent, out may be NULL
+ */
+bool wilde_verify(struct wilde_verify *out);
+
+#ifdef CONFIG_LIBWILDE_SMP
+/*
+ * Multi-core support, the platform brings every CPU online with
+ * wilde_smp_cpu_online() as it comes up, 0 being the boot CPU, and hands the
+ * function interrupting a mask of CPUs to wilde_smp_ipi_set(). That interrupt
+ * has to call wilde_smp_shootdown() on every CPU it reaches.
+ *
+ * Every core has to be brought online before it calls into wilde. One that
+ * isn't has no id, it would share CPU 0's per CPU state and never be
+ * interrupted, so wilde crashes once it calls in after any other CPU was
+ * brought online or an IPI function was set.
+ *
+ * Unmaps interrupt every other online CPU. An application that knows which
+ * cores use aliases narrows that down with wilde_smp_touch(): after its first
+ * call only CPUs that called into wilde or wilde_smp_touch() are interrupted,
+ * so one that gets to aliases through pointers another CPU handed it calls
+ * wilde_smp_touch() once before using them.
+ */
+void wilde_smp_cpu_online(unsigned cpu);
+void wilde_smp_ipi_set(void (*send)(uint64_t cpus));
+void wilde_smp_shootdown(void);
+void wilde_smp_touch(void);
+#endif
+
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+/*
+ * objects kept ready per hot size class, at most
+ * CONFIG_LIBWILDE_MAGAZINE_DEPTH. A lower depth takes effect as the
+ * magazines are used up
+ */
+void wilde_magazine_depth_set(unsigned depth);
+unsigned wilde_magazine_depth_get(void);
+
+/*
+ * tops up the magazines of the hot size classes, what the background thread
+ * does every CONFIG_LIBWILDE_MAGAZINE_INTERVAL us. Useful before a latency
+ * critical stretch, or without a scheduler
+ */
+void wilde_magazine_refill(void);
+#endif
+
+#ifdef CONFIG_LIBWILDE_PRESSURE
+/*
+ * gives back everything wilde keeps without it being in use, as it does by
+ * itself when availmem runs low or the backing allocator fails. For a low
+ * memory notification of the platform, returns the bytes availmem went up by
+ */
+size_t wilde_pressure(void);
+#endif
+
+#ifdef CONFIG_LIBWILDE_RELEASE
+/*
+ * gives back the memory of the whole pages in [ptr + off, ptr + off + len),
+ * like madvise(MADV_DONTNEED). ptr is an allocation of malloc & co, the pages
+ * stay reserved to it but fault until wilde_commit() maps them in again.
+ * free() and realloc() work as usual, realloc() reads released pages as 0.
+ *
+ * returns the bytes given back, -EINVAL when ptr isn't the start of an
+ * allocation or the range goes past its usable size
+ */
+ssize_t wilde_release(void *ptr, size_t off, size_t len);
+
+/*
+ * maps zeroed memory in for the released pages [ptr + off, ptr + off + len)
+ * touches, pages still mapped stay as they are
+ *
+ * returns the bytes mapped in, -EINVAL as for wilde_release and -ENOMEM when
+ * the backing allocator ran out, the pages mapped in until then stay
+ */
+ssize_t wilde_commit(void *ptr, size_t off, size_t len);
+#endif
+
+#ifdef CONFIG_LIBWILDE_FOREIGN
+/*
+ * a fresh alias of the len bytes at buf without copying them, for buffers
+ * wilde doesn't own like device rings. buf is identity mapped memory or
+ * memory wilde handed out, physically contiguous. The alias covers the whole
+ * pages buf lies in and stays until wilde_unmap_foreign(), unmap it before
+ * the buffer is recycled so stale pointers fault. free() of it is an invalid
+ * free. It doesn't count as live memory in wilde_stats.
+ *
+ * NULL for a buf that can't be aliased, or once the alias window ran out
+ */
+void *wilde_map_foreign(const void *buf, size_t len);
+
+/*
+ * revokes an alias of wilde_map_foreign, the buffer itself is left alone.
+ * Returns 0, or -EINVAL for anything but such an alias
+ */
+int wilde_unmap_foreign(void *alias);
+#endif
+
+#ifdef CONFIG_LIBWILDE_RECLAIM
+/*
+ * frees page tables of huge frees still queued for about cycles, or until
+ * there are none left for 0. Returns how many are left
+ */
+size_t wilde_reclaim(uint64_t cycles);
+#endif
+
+#ifdef CONFIG_LIBWILDE_ARENA
+struct wilde_arena;
+
+/*
+ * creates an arena of up to size bytes of objects, in a sub-window of its
+ * own. NULL when the window or the backing allocator ran out
+ */
+struct wilde_arena *wilde_arena_create(size_t size);
+
+/*
+ * an object of size bytes aligned to 16, or to align. NULL when the arena is
+ * full or the backing allocator ran out. Objects can't be freed on their own
+ */
+void *wilde_arena_alloc(struct wilde_arena *arena, size_t size);
+void *wilde_arena_memalign(struct wilde_arena *arena, size_t align,
+                           size_t size);
+
+/*
+ * frees every object of the arena at once, in one pass over the page tables
+ * with a single TLB flush. Any pointer into it faults from then on
+ */
+void wilde_arena_destroy(struct wilde_arena *arena);
+#endif
+
+#ifdef CONFIG_LIBWILDE_CACHE
+struct wilde_cache;
+
+/*
+ * creates a cache of size byte objects aligned to align, ctor (may be NULL)
+ * runs once on every object before it's handed out. NULL when out of memory
+ * or for an align that isn't a power of 2
+ */
+struct wilde_cache *wilde_cache_create(size_t size, size_t align,
+                                       void (*ctor)(void *obj));
+
+/* a constructed object behind a fresh alias, NULL when out of memory */
+void *wilde_cache_alloc(struct wilde_cache *cache);
+
+/*
+ * frees an object of cache like free() does, its alias is never reused. An
+ * object of another size is an invalid free
+ */
+void wilde_cache_free(struct wilde_cache *cache, void *obj);
+
+/* frees the prepared objects and the cache, its objects must be freed before */
+void wilde_cache_destroy(struct wilde_cache *cache);
+#endif
+
+/* how an allocation gets protected */
+enum wilde_mode {
+  WILDE_MODE_ALIAS = 0,   /* a fresh alias, the default */
+  WILDE_MODE_GUARD,       /* a fresh alias with an unmapped page behind it */
+  WILDE_MODE_SAMPLED,     /* an alias for 1 in N, see wilde_sample_rate_set */
+  WILDE_MODE_PASSTHROUGH, /* straight to the backing allocator */
+};
+
+#ifdef CONFIG_LIBWILDE_SAMPLER
+/*
+ * protect on average 1 in rate malloc/calloc/realloc allocations, rate 1
+ * protects everything
+ */
+void wilde_sample_rate_set(unsigned rate);
+unsigned wilde_sample_rate_get(void);
+#endif
+
+#ifdef CONFIG_LIBWILDE_POLICY
+/*
+ * a policy rule, matching either a call site (caller != 0) or the size range
+ * [min_size, max_size]
+ */
+struct wilde_policy_rule {
+  uintptr_t caller;     /* return address of the call site */
+  size_t min_size;
+  size_t max_size;
+  enum wilde_mode mode;
+};
+
+/*
+ * replaces the policy table, anything not matched by a rule gets default_mode
+ *
+ * returns 0 on success, -EINVAL for an invalid rule and -ENOSPC when there
+ * are too many call sites, the table is left untouched on failure
+ */
+int wilde_policy_load(const struct wilde_policy_rule *rules, size_t nr_rules,
+                      enum wilde_mode default_mode);
+
+/*
+ * same as wilde_policy_load, but parses rules in the LIBWILDE_POLICY_RULES
+ * format, e.g. "size:0-63=pass,caller:0x11a2f0=guard"
+ */
+int wilde_policy_parse(const char *rules, enum wilde_mode default_mode);
+#endif
+
 // TMP
 void remap_range(void *from, void *to, size_t size);
 void unmap_range(void *addr, size_t size);
 
 
+#ifdef CONFIG_LIBWILDE_STATS
+
+#define WILDE_STATS_ORDERS 32 /* buddy orders tracked, the last one catches all above */
+#define WILDE_STATS_PROBES 8  /* alias probe length buckets, log2 */
+#define WILDE_STATS_CLASSES 48 /* log2 size classes */
+
+/* live aliased objects of one size class, [2^i, 2^(i+1)) bytes */
+struct wilde_stats_class {
+  uint64_t objects;
+  uint64_t requested; /* bytes asked for */
+  uint64_t physical;  /* bytes held in the backing allocator, >= requested */
+};
+
+struct wilde_stats {
+  uint64_t calls[WILDE_CALLS];  /* calls per shim entry point */
+  uint64_t passthrough;         /* allocations that bypassed wilde */
+
+  /* aliased objects, live and the high water mark */
+  uint64_t live_bytes;
+  uint64_t live_objects;
+  uint64_t peak_bytes;
+  uint64_t peak_objects;
+
+  /* mapping engine */
+  uint64_t ptes_set;
+  uint64_t ptes_cleared;
+  uint64_t pt_pages_alloc;
+  uint64_t pt_pages_freed;
+  uint64_t tlb_flushes;
+  uint64_t tlb_shootdowns;  /* batches other CPUs had to invalidate */
+  uint64_t tlb_ipis;        /* CPUs interrupted for them */
+  uint64_t reclaim_queued;   /* detached tables of huge frees, not freed yet */
+
+  /* magazines of prepared objects */
+  uint64_t magazine_depth;   /* objects kept ready per malloc magazine */
+  uint64_t magazine_objects; /* prepared and waiting, counted as live too */
+  uint64_t magazine_hits;
+  uint64_t magazine_misses;
+
+  /* object caches, wilde_cache_create() */
+  uint64_t cache_objects;    /* prepared and waiting, counted as live too */
+  uint64_t cache_hits;
+  uint64_t cache_misses;
+
+  /* alias table, probes[i] counts lookups walking [2^i - 1, 2^(i+1) - 1) entries */
+  uint64_t alias_entries;
+  uint64_t alias_buckets;
+  uint64_t alias_lookups;
+  uint64_t alias_probes[WILDE_STATS_PROBES];
+
+  /* virtual memory of the malloc and palloc windows */
+  uint64_t va_used;
+  uint64_t va_remaining;
+  uint64_t palloc_va_used;
+  uint64_t palloc_va_remaining;
+
+  /* orders asked of the backing buddy allocator and of the palloc window */
+  uint64_t buddy_orders[WILDE_STATS_ORDERS];
+  uint64_t va_orders[WILDE_STATS_ORDERS];
+
+  /* memory overhead, physical - requested is the rounding waste */
+  uint64_t requested_bytes;
+  uint64_t physical_bytes;
+  uint64_t pt_pages;       /* page tables wilde allocated and holds */
+  uint64_t metadata_pages; /* alias and vma batches */
+  struct wilde_stats_class classes[WILDE_STATS_CLASSES];
+};
+
+/* takes a snapshot of the statistics, summing up all CPUs */
+void wilde_stats_get(struct wilde_stats *out);
+
+/* resets the counters, live, peak and window figures are kept */
+void wilde_stats_reset(void);
+
+/* prints the statistics to the console */
+void wilde_stats_dump(void);
+#endif
+
+#ifdef CONFIG_LIBWILDE_LATENCY
+/* phases of wilde_map_new, wilde_map_rm and the shim around them */
+enum wilde_phase {
+  WILDE_PHASE_BACKING_ALLOC = 0, /* backing allocator, kallocs or buddy */
+  WILDE_PHASE_VMEM_WALK,         /* finding a fit in vmem_free */
+  WILDE_PHASE_VMA_SPLIT,         /* splitting it off */
+  WILDE_PHASE_VBUDDY,            /* palloc window allocation */
+  WILDE_PHASE_ALIAS_REGISTER,
+  WILDE_PHASE_REMAP,             /* remap_range, page table creation included */
+  WILDE_PHASE_CLEAR,             /* memory initialisation */
+  WILDE_PHASE_ALIAS_SEARCH,
+  WILDE_PHASE_UNMAP,             /* unmap_range, TLB flushes included */
+  WILDE_PHASE_ALIAS_UNREGISTER,
+  WILDE_PHASE_BACKING_FREE,
+  WILDE_PHASES
+};
+
+/* buckets[i] counts measurements of [2^i, 2^(i+1)) cycles */
+#define WILDE_LATENCY_BUCKETS 40
+
+struct wilde_latency {
+  uint64_t count;
+  uint64_t cycles;
+  uint64_t buckets[WILDE_LATENCY_BUCKETS];
+};
+
+/* histogram of phase, summing up all CPUs */
+void wilde_latency_get(enum wilde_phase phase, struct wilde_latency *out);
+void wilde_latency_reset(void);
+void wilde_latency_dump(void);
+#endif
+
+#ifdef CONFIG_LIBWILDE_TRACE
+/*
+ * moves up to max of the oldest trace records into buf, returns how many.
+ * Records of CPU 0 come first, then those of CPU 1 etc. Safe to call from any
+ * CPU while the others keep allocating. Under LIBWILDE_TRACE_LOSSLESS a CPU
+ * emptying its full ring waits for a drain, but never holds the allocator
+ * lock meanwhile.
+ */
+size_t wilde_trace_drain(struct wilde_trace_record *buf, size_t max);
+
+/*
+ * records lost because the ring wrapped and overwrote them before they were
+ * drained, or while they were, by a drain on another CPU
+ */
+uint64_t wilde_trace_lost(void);
+
+/* drains the whole trace to the console, for tools/wilde-trace to decode */
+void wilde_trace_dump(void);
+#endif
+
+#ifdef CONFIG_LIBWILDE_PROFILE
+#define WILDE_PROFILE_DEPTH CONFIG_LIBWILDE_PROFILE_DEPTH
+
+/* counts are of sampled allocations, not scaled up */
+struct wilde_profile_site {
+  uintptr_t stack[WILDE_PROFILE_DEPTH]; /* return addresses, innermost first */
+  unsigned depth;
+  uint64_t alloc_objects; /* ever allocated here */
+  uint64_t alloc_bytes;
+  uint64_t live_objects;  /* allocated here and not freed yet */
+  uint64_t live_bytes;
+  uint64_t live_pages;    /* alias window pages they hold */
+};
+
+/* copies up to max allocation sites into buf, returns how many */
+size_t wilde_profile_get(struct wilde_profile_site *buf, size_t max);
+
+/* average bytes allocated between two samples */
+void wilde_profile_interval_set(size_t bytes);
+size_t wilde_profile_interval_get(void);
+
+/* samples not recorded because the site table was full */
+uint64_t wilde_profile_dropped(void);
+
+/* prints the profile in the pprof legacy heap format */
+void wilde_profile_dump(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,64 @@
+#ifndef __WILDE_TRACE_H__
+#define __WILDE_TRACE_H__
+
+/*
+ * Record format of the allocation trace, see CONFIG_LIBWILDE_TRACE
+ *
+ * Kept free of unikraft headers, it's shared with the host side tools in
+ * tools/
+ */
+#include <stdint.h>
+
+#define WILDE_TRACE_VERSION 1
+
+/* shim entry points, indexes wilde_stats.calls and tags trace records */
+enum wilde_call {
+  WILDE_CALL_MALLOC = 0,
+  WILDE_CALL_CALLOC,
+  WILDE_CALL_REALLOC,
+  WILDE_CALL_POSIX_MEMALIGN,
+  WILDE_CALL_MEMALIGN,
+  WILDE_CALL_FREE,
+  WILDE_CALL_PALLOC,
+  WILDE_CALL_PFREE,
+  WILDE_CALL_ADDMEM,
+  WILDE_CALL_AVAILMEM,
+  WILDE_CALLS
+};
+
+struct wilde_trace_record {
+  uint64_t tsc;    /* rdtsc at the time of the call */
+  uint64_t size;   /* requested size in bytes */
+  uint64_t alias;  /* pointer returned or freed */
+  uint64_t origin; /* backing address, 0 if passed through */
+  uint64_t caller; /* return address of the call site */
+  uint64_t aux;    /* realloc: old pointer, memalign: alignment, palloc: order */
+  uint32_t op;     /* enum wilde_call */
+  uint32_t cpu;
+};
+
+/*
+ * Replay format, a trace as produced by tools/wilde-trace -r: the calls in
+ * order, pointers replaced by object ids so it can be driven against any
+ * allocator. A file is a header followed by nr records.
+ */
+#define WILDE_REPLAY_MAGIC 0x59414c5045524c57ULL /* "WLREPLAY" */
+#define WILDE_REPLAY_VERSION 1
+
+struct wilde_replay_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t objects; /* ids run from 1 to objects */
+  uint64_t nr;      /* records following the header */
+};
+
+struct wilde_replay_record {
+  uint64_t size;   /* requested bytes, palloc and pfree: 0 */
+  uint32_t dtsc;   /* cycles since the previous call, saturated */
+  uint32_t id;     /* object allocated or freed, 0 if unknown or failed */
+  uint32_t old_id; /* realloc: the object resized */
+  uint16_t op;     /* enum wilde_call */
+  uint16_t order;  /* log2 of the alignment, palloc and pfree: the order */
+};
+
+#endif /* __WILDE_TRACE_H__ */
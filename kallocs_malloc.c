@@ -1,5 +1,6 @@
 #include "kallocs_malloc.h"
 #include "shimming.h"
+#include "stats.h"
 #include <uk/assert.h>
 #include <string.h>
 
@@ -24,11 +25,12 @@ void *kallocs_malloc(size_t size)
 
     /* find min order, s.t. __PAGE_SIZE << order is bigger than size */
     int order = min_page_order(size);
+    STAT_ORDER(buddy_orders, order);
 
-    /* allocate required memory */
+    /* allocate required memory, the shim deals with running out */
     char *memory = shimmed->palloc(shimmed, order);
     if (memory == NULL)
-        UK_CRASH("Couldn't allocate enough memory");
+        return NULL;
 
     /* find the end of said memory */
     char *end_memory = memory + (__PAGE_SIZE << order);
@@ -41,6 +43,8 @@ void *kallocs_calloc(size_t nmemb, size_t size)
 {
     /* repurpose kallocs_malloc as this is roughly the same */
     void *buffer = kallocs_malloc(nmemb * size);
+    if (buffer == NULL)
+        return NULL;
 
     /* don't forget to set the buffer to 0 */
     memset(buffer, 0, nmemb * size);
@@ -53,19 +57,24 @@ void *kallocs_memalign(size_t align, size_t size)
     if (size == 0)
         UK_CRASH("memalign requested size 0\n");
 
-    if (!IS_POWER_2(align) || align < sizeof(void *) || align > __PAGE_SIZE)
+    if (!IS_POWER_2(align) || align < sizeof(void *))
         UK_CRASH("memalign align %ld is wack\n", align);
 
-    /* figure out number of pages required */
-    uintptr_t pages = ROUNDUP(size, __PAGE_SIZE);
+    /*
+     * Anything aligned beyond a page is taken care of by aligning the alias,
+     * physically a page aligned spot is all we need, so no extra order
+     */
+    if (align > __PAGE_SIZE)
+        align = __PAGE_SIZE;
 
-    /* find order s.t. pages <= (__PAGE_SIZE << order) */
-    int order = ilog2(pages - 1) - ilog2(__PAGE_SIZE) + 1;
+    /* same order as malloc, so kallocs_free can find the block from size */
+    int order = min_page_order(size);
+    STAT_ORDER(buddy_orders, order);
 
-    /* allocate required memory */
+    /* allocate required memory, the shim deals with running out */
     char *memory = shimmed->palloc(shimmed, order);
     if (memory == NULL)
-        UK_CRASH("Couldn't allocate enough memory");
+        return NULL;
 
     /* find the end of said memory */
     char *end_memory = memory + (__PAGE_SIZE << order);
@@ -79,7 +88,11 @@ void *kallocs_realloc(void *ptr, size_t old_size, size_t size)
     if (old_size == size)
         return ptr;
 
+    /* like realloc, ptr stays as it is when there's no memory */
     void *new_ptr = kallocs_malloc(size);
+    if (new_ptr == NULL)
+        return NULL;
+
     size_t copy_size = old_size < size ? old_size : size;
     memcpy(new_ptr, ptr, copy_size);
     kallocs_free(ptr, old_size);
@@ -93,4 +106,10 @@ void kallocs_free(void *ptr, size_t size)
     size_t mask = ~(p - 1);
 
     shimmed->pfree(shimmed, (void *)((uintptr_t) ptr & mask), order);
-}
\ No newline at end of file
+}
+
+/* size of the buddy block an object of size bytes lives in */
+size_t kallocs_block_size(size_t size)
+{
+    return __PAGE_SIZE << min_page_order(size);
+}
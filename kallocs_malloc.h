@@ -68,5 +68,6 @@ void   *kallocs_calloc(size_t nmemb, size_t size);
 void   *kallocs_memalign(size_t align, size_t size);
 void   *kallocs_realloc(void *ptr, size_t old_size, size_t size);
 void    kallocs_free(void *ptr, size_t size);
+size_t  kallocs_block_size(size_t size);
 
 #endif // __WILDE_KALLOCS_H__
\ No newline at end of file
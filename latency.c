@@ -0,0 +1,51 @@
+#define COLOR COLOR_WHITE
+
+#include <string.h>
+#include "latency.h"
+#include "util.h"
+
+struct wilde_latency latency_pcpu[WILDE_NR_CPUS][WILDE_PHASES];
+
+void wilde_latency_get(enum wilde_phase phase, struct wilde_latency *out)
+{
+  memset(out, 0, sizeof(*out));
+
+  for (int cpu = 0; cpu < WILDE_NR_CPUS; cpu++) {
+    const struct wilde_latency *l = &latency_pcpu[cpu][phase];
+
+    out->count += l->count;
+    out->cycles += l->cycles;
+    for (int i = 0; i < WILDE_LATENCY_BUCKETS; i++)
+      out->buckets[i] += l->buckets[i];
+  }
+}
+
+void wilde_latency_reset(void)
+{
+  memset(latency_pcpu, 0, sizeof(latency_pcpu));
+}
+
+void wilde_latency_dump(void)
+{
+  static const char *const names[WILDE_PHASES] = {
+    "backing alloc", "vmem walk", "vma split", "vbuddy", "alias register",
+    "remap", "clear", "alias search", "unmap", "alias unregister",
+    "backing free",
+  };
+
+  lprintf("wilde latency in cycles, count/mean then count per log2 bucket\n");
+
+  for (int p = 0; p < WILDE_PHASES; p++) {
+    struct wilde_latency l;
+    wilde_latency_get(p, &l);
+
+    if (!l.count)
+      continue;
+
+    hprintf("  %-16s %lu/%lu", names[p], l.count, l.cycles / l.count);
+    for (int i = 0; i < WILDE_LATENCY_BUCKETS; i++)
+      if (l.buckets[i])
+        hprintf(" 2^%d:%lu", i, l.buckets[i]);
+    hprintf("\n");
+  }
+}
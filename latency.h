@@ -0,0 +1,42 @@
+#ifndef __WILDE_LATENCY_H__
+#define __WILDE_LATENCY_H__
+#include <wilde.h>
+#include "percpu.h"
+#include "util.h"
+#include "x86.h"
+
+/*
+ * rdtsc based latency histograms per phase
+ *
+ *   LAT_BEGIN(t);
+ *   remap_range(...);
+ *   LAT_END(WILDE_PHASE_REMAP, t);
+ *
+ * both compile out without CONFIG_LIBWILDE_LATENCY
+ */
+
+#ifdef CONFIG_LIBWILDE_LATENCY
+
+extern struct wilde_latency latency_pcpu[WILDE_NR_CPUS][WILDE_PHASES];
+
+static inline void latency_record(enum wilde_phase phase, u64 cycles)
+{
+  struct wilde_latency *l = &PERCPU(latency_pcpu)[phase];
+  int bucket = LOG2(cycles | 1);
+
+  l->count++;
+  l->cycles += cycles;
+  l->buckets[MIN(bucket, WILDE_LATENCY_BUCKETS - 1)]++;
+}
+
+#define LAT_BEGIN(Var) u64 Var = rdtsc()
+#define LAT_END(Phase, Var) latency_record((Phase), rdtsc() - (Var))
+
+#else
+
+#define LAT_BEGIN(Var) do {} while (0)
+#define LAT_END(Phase, Var) do {} while (0)
+
+#endif /* CONFIG_LIBWILDE_LATENCY */
+
+#endif /* __WILDE_LATENCY_H__ */
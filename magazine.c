@@ -0,0 +1,99 @@
+#define COLOR COLOR_PURPLE
+
+#include <uk/assert.h>
+#include "magazine.h"
+#include "stats.h"
+#include "util.h"
+
+#ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
+  #error "Magazines depend on the wilde engine"
+#endif
+
+struct magazine magazines[MAGAZINE_HOT];
+unsigned magazine_depth = MAGAZINE_MAX_DEPTH;
+
+static u32 traffic[MAGAZINE_CLASSES];
+static u8 hot[MAGAZINE_CLASSES] = {[0 ... MAGAZINE_CLASSES - 1] = MAGAZINE_NONE};
+static unsigned noted;
+
+/* picks the MAGAZINE_HOT busiest classes, a few passes over a small table */
+static void magazine_learn(void)
+{
+  bool taken[MAGAZINE_CLASSES] = {0};
+  unsigned picked[MAGAZINE_HOT];
+
+  for (unsigned i = 0; i < MAGAZINE_HOT; i++) {
+    unsigned best = 0;
+    u32 most = 0;
+
+    for (unsigned c = 1; c < MAGAZINE_CLASSES; c++)
+      if (!taken[c] && traffic[c] > most) {
+        best = c;
+        most = traffic[c];
+      }
+
+    picked[i] = best;
+    taken[best] = true;
+  }
+
+  for (unsigned c = 0; c < MAGAZINE_CLASSES; c++) {
+    hot[c] = MAGAZINE_NONE;
+    traffic[c] /= 2;
+  }
+
+  /* a class that stays hot keeps its magazine, objects and all */
+  bool kept[MAGAZINE_HOT] = {0};
+  for (unsigned i = 0; i < MAGAZINE_HOT; i++)
+    for (unsigned j = 0; j < MAGAZINE_HOT && picked[i]; j++)
+      if (!kept[j] && magazines[j].want == picked[i]) {
+        hot[picked[i]] = j;
+        kept[j] = true;
+        picked[i] = 0;
+      }
+
+  /* the others take over the magazines of classes gone cold */
+  unsigned j = 0;
+  for (unsigned i = 0; i < MAGAZINE_HOT; i++) {
+    if (!picked[i])
+      continue;
+
+    while (kept[j])
+      j++;
+    magazines[j].want = picked[i];
+    hot[picked[i]] = j;
+    kept[j] = true;
+  }
+
+  for (j = 0; j < MAGAZINE_HOT; j++)
+    if (!kept[j])
+      magazines[j].want = 0;
+}
+
+bool magazine_note(size_t size)
+{
+  traffic[magazine_class(size)]++;
+
+  if (++noted < MAGAZINE_EPOCH)
+    return false;
+
+  noted = 0;
+  magazine_learn();
+  return true;
+}
+
+void *magazine_pop(size_t size)
+{
+  unsigned class = magazine_class(size);
+  if (!class || hot[class] == MAGAZINE_NONE)
+    return NULL;
+
+  struct magazine *m = &magazines[hot[class]];
+  if (m->class != class || !m->count) {
+    STAT_INC(magazine_misses);
+    return NULL;
+  }
+
+  STAT_INC(magazine_hits);
+  STAT_MAGAZINE(-1);
+  return m->objs[--m->count];
+}
@@ -0,0 +1,63 @@
+#ifndef __WILDE_MAGAZINE_H__
+#define __WILDE_MAGAZINE_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "util.h"
+
+/*
+ * Magazines of prepared malloc objects for the hottest sizes.
+ *
+ * Sizes up to MAGAZINE_MAX_SIZE fall into classes of MAGAZINE_GRAIN bytes.
+ * Every malloc is counted against its class, and every MAGAZINE_EPOCH of them
+ * the MAGAZINE_HOT busiest classes get a magazine each. The counts are halved
+ * at every epoch, so the choice follows the traffic as it changes.
+ *
+ * A background thread keeps the magazines topped up with objects behind a
+ * fresh alias, cleared and registered at the size of their class, so a malloc
+ * of a hot size is a pop. A magazine whose class went cold hands its objects
+ * back before it's refilled for the new one.
+ *
+ * Everything here expects the allocator lock to be held, the objects are
+ * prepared and torn down in shimming.c.
+ */
+
+#define MAGAZINE_GRAIN 16
+#define MAGAZINE_MAX_SIZE 1024
+#define MAGAZINE_CLASSES (MAGAZINE_MAX_SIZE / MAGAZINE_GRAIN + 1)
+#define MAGAZINE_HOT CONFIG_LIBWILDE_MAGAZINE_HOT
+#define MAGAZINE_MAX_DEPTH CONFIG_LIBWILDE_MAGAZINE_DEPTH
+#define MAGAZINE_EPOCH 4096 /* mallocs between two choices of hot classes */
+#define MAGAZINE_NONE 0xff
+
+struct magazine {
+  unsigned class; /* class of the objects in it, 0 for none */
+  unsigned want;  /* class it should hold */
+  unsigned count;
+  void *objs[MAGAZINE_MAX_DEPTH];
+};
+
+extern struct magazine magazines[MAGAZINE_HOT];
+extern unsigned magazine_depth; /* objects kept per magazine, tunable */
+
+/* class of size, 0 for sizes too large to have one */
+static inline unsigned magazine_class(size_t size)
+{
+  return size <= MAGAZINE_MAX_SIZE ? (size + MAGAZINE_GRAIN - 1) / MAGAZINE_GRAIN : 0;
+}
+
+static inline size_t magazine_class_size(unsigned class)
+{
+  return class * MAGAZINE_GRAIN;
+}
+
+/*
+ * counts a malloc of size bytes, returns true when that ended an epoch and
+ * new hot classes were picked
+ */
+bool magazine_note(size_t size);
+
+/* an object of size's class, NULL when it isn't hot or the magazine is empty */
+void *magazine_pop(size_t size);
+
+#endif /* __WILDE_MAGAZINE_H__ */
@@ -3,7 +3,11 @@
 #include "pagetables.h"
 #include "x86.h"
 #include "shimming.h"
+#include "stats.h"
+#include "shootdown.h"
+#include "wilde_internal.h"
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include <uk/plat/console.h>
 
@@ -97,11 +101,45 @@ static inline uintptr_t pt_create()
     UK_CRASH("Couldn't allocate a page table");
 
   memset(page, 0, __PAGE_SIZE);
+  STAT_INC(pt_pages_alloc);
+  STAT_PT_PAGES(1);
 
   dprintf("Allocated new page at %p\n", page);
   return (uintptr_t)page;
 }
 
+static inline void pt_free(uintptr_t *pgtable)
+{
+  shimmed->pfree(shimmed, pgtable, 0);
+  STAT_INC(pt_pages_freed);
+  STAT_PT_PAGES(-1);
+}
+
+/*
+ * Tables unhooked while unmapping can stay in other CPUs' paging structure
+ * caches until shootdown_finish(), and the backing allocator runs outside the
+ * allocator lock, so one handed out again right away could be written to
+ * while a CPU still walks through it. They wait here for pt_free_dropped(),
+ * chained through their first entry.
+ */
+static uintptr_t *pt_dropped;
+
+static inline void pt_drop(uintptr_t *pgtable)
+{
+  /* page aligned, the link reads as a non present entry */
+  pgtable[0] = (uintptr_t)pt_dropped;
+  pt_dropped = pgtable;
+}
+
+void pt_free_dropped(void)
+{
+  while (pt_dropped) {
+    uintptr_t *pgtable = pt_dropped;
+    pt_dropped = (uintptr_t *)pgtable[0];
+    pt_free(pgtable);
+  }
+}
+
 /*
  * tries to remove/free pt
  */
@@ -121,7 +159,7 @@ static inline bool pt_try_remove(uintptr_t *pgdir_entry, uintptr_t *pgtable)
 
   /* we can remove it */
   *pgdir_entry = 0;
-  shimmed->pfree(shimmed, pgtable, 0);
+  pt_drop(pgtable);
 
   return true;
 }
@@ -248,14 +286,150 @@ void print_pgtables(bool skip_first_gb)
   print_p1(p1_p, skip_first_gb);
 }
 
+/*
+ * Page table census, the same walk as print_pgtables without the printing,
+ * so it only touches the entries. Tables that map nothing but alias window
+ * addresses are wilde's page table overhead.
+ */
+static inline bool census_in_window(uintptr_t vaddr, uintptr_t span)
+{
+  return vaddr >= VMAP_START && vaddr + span <= VMAP_START + VMAP_SIZE;
+}
+
+static void census_p4(struct wilde_pt_census *c, p4_t *p4_p)
+{
+  unsigned present = 0;
+
+  for (uintptr_t p4 = 0; p4 < PT_P4_ENTRIES; p4++)
+    present += p4_p[p4] & PT_P4_PRESENT;
+
+  c->tables[3]++;
+  c->present[3] += present;
+  c->pages_4k += present;
+  if (present < WILDE_PT_SPARSE)
+    c->sparse_p4++;
+}
+
+static void census_p3(struct wilde_pt_census *c, p3_t *p3_p, uintptr_t vaddr)
+{
+  c->tables[2]++;
+
+  for (uintptr_t p3 = 0; p3 < PT_P3_ENTRIES; p3++) {
+    p3_t p3_e = p3_p[p3];
+    uintptr_t p3_v = vaddr + (p3 << PT_P3_VA_SHIFT);
+
+    if (!(p3_e & PT_P3_PRESENT))
+      continue;
+
+    c->present[2]++;
+    if (p3_e & PT_P3_2MB) {
+      c->pages_2m++;
+      continue;
+    }
+
+    if (census_in_window(p3_v, 1ULL << PT_P3_VA_SHIFT))
+      c->window_tables++;
+    census_p4(c, pt_pte_to_pt(&p3_e));
+  }
+}
+
+static void census_p2(struct wilde_pt_census *c, p2_t *p2_p, uintptr_t vaddr)
+{
+  c->tables[1]++;
+
+  for (uintptr_t p2 = 0; p2 < PT_P2_ENTRIES; p2++) {
+    p2_t p2_e = p2_p[p2];
+    uintptr_t p2_v = vaddr + (p2 << PT_P2_VA_SHIFT);
+
+    if (!(p2_e & PT_P2_PRESENT))
+      continue;
+
+    c->present[1]++;
+    if (p2_e & PT_P2_1GB) {
+      c->pages_1g++;
+      continue;
+    }
+
+    if (census_in_window(p2_v, 1ULL << PT_P2_VA_SHIFT))
+      c->window_tables++;
+    census_p3(c, pt_pte_to_pt(&p2_e), p2_v);
+  }
+}
+
+void wilde_pt_census(struct wilde_pt_census *out)
+{
+  p1_t *p1_p = (p1_t *)rcr3(true);
+
+  memset(out, 0, sizeof(*out));
+  out->tables[0] = 1;
+
+  for (uintptr_t p1 = 0; p1 < PT_P1_ENTRIES; p1++) {
+    p1_t p1_e = p1_p[p1];
+    uintptr_t p1_v = p1 << PT_P1_VA_SHIFT;
+
+    if (!(p1_e & PT_P1_PRESENT))
+      continue;
+
+    out->present[0]++;
+    if (census_in_window(p1_v, 1ULL << PT_P1_VA_SHIFT))
+      out->window_tables++;
+    census_p2(out, pt_pte_to_pt(&p1_e), p1_v);
+  }
+
+  out->window_bytes = out->window_tables * __PAGE_SIZE;
+}
+
+/*
+ * frees the empty p3 and p4 tables of the alias window, the ones unmap_range
+ * leaves behind on purpose. A walk over every table of the window, so only
+ * for memory pressure
+ */
+size_t pt_sweep(void)
+{
+  p1_t *p1_p = (p1_t *)rcr3(true);
+  uintptr_t last = VMAP_START + VMAP_SIZE - 1;
+  size_t freed = 0;
+
+  for (uintptr_t p1 = PT_P1_IDX(VMAP_START); p1 <= PT_P1_IDX(last); p1++) {
+    if (!(p1_p[p1] & PT_P1_PRESENT))
+      continue;
+
+    p2_t *p2_p = pt_pte_to_pt(&p1_p[p1]);
+    for (uintptr_t p2 = 0; p2 < PT_P2_ENTRIES; p2++) {
+      if (!(p2_p[p2] & PT_P2_PRESENT) || p2_p[p2] & PT_P2_1GB)
+        continue;
+
+      p3_t *p3_p = pt_pte_to_pt(&p2_p[p2]);
+      for (uintptr_t p3 = 0; p3 < PT_P3_ENTRIES; p3++) {
+        if (!(p3_p[p3] & PT_P3_PRESENT) || p3_p[p3] & PT_P3_2MB)
+          continue;
+
+        freed += pt_try_remove(&p3_p[p3], pt_pte_to_pt(&p3_p[p3]));
+      }
+
+      freed += pt_try_remove(&p2_p[p2], p3_p);
+    }
+  }
+
+  /* the paging structure caches may still point at them */
+  if (freed) {
+    shootdown_all();
+    shootdown_finish();
+    pt_free_dropped();
+  }
+
+  return freed;
+}
+
 static inline uintptr_t *pt_next(uintptr_t *ptr, size_t index, uintptr_t flags, bool create)
 {
   UK_ASSERT(index < PT_P1_ENTRIES);
-  UK_ASSERT((uintptr_t) ptr < (1 * GB));
 
   if (!ptr)
     return NULL;
 
+  PT_ASSERT_PHYS(ptr);
+
   if ((ptr[index] & flags) == flags)
     return (uintptr_t *)(ptr[index] & PT_MASK_ADDR);
 
@@ -269,93 +443,167 @@ static inline uintptr_t *pt_next(uintptr_t *ptr, size_t index, uintptr_t flags,
   return (uintptr_t *)next;
 }
 
-void remap_range(void *from, void *to, size_t size)
+/*
+ * walks the page tables for vaddr without creating anything
+ *
+ * returns the physical address vaddr maps to, 0 when it isn't mapped
+ */
+uintptr_t pt_get_phys(uintptr_t vaddr)
 {
-  // hprintf("Remapping range %p-%p => %p-%p\n", from, from + size - 1, to,
-          // to + size - 1);
+  p1_t *p1 = (p1_t *)rcr3(true);
+  p2_t *p2 = pt_next(p1, PT_P1_IDX(vaddr), PT_P1_PRESENT, false);
+  if (!p2)
+    return 0;
 
-  /* I'm lazy, assume from is phys */
-  UK_ASSERT((uintptr_t)from < (1 * GB));
+  p2_t p2_e = p2[PT_P2_IDX(vaddr)];
+  if (p2_e & PT_P2_PRESENT && p2_e & PT_P2_1GB)
+    return (p2_e & PT_MASK_ADDR) + (vaddr & MASK_1GB);
+
+  p3_t *p3 = pt_next(p2, PT_P2_IDX(vaddr), PT_P2_PRESENT, false);
+  if (!p3)
+    return 0;
+
+  p3_t p3_e = p3[PT_P3_IDX(vaddr)];
+  if (p3_e & PT_P3_PRESENT && p3_e & PT_P3_2MB)
+    return (p3_e & PT_MASK_ADDR) + (vaddr & MASK_2MB);
+
+  p4_t *p4 = pt_next(p3, PT_P3_IDX(vaddr), PT_P3_PRESENT, false);
+  if (!p4 || !(p4[PT_P4_IDX(vaddr)] & PT_P4_PRESENT))
+    return 0;
+
+  return (p4[PT_P4_IDX(vaddr)] & PT_MASK_ADDR) + (vaddr & MASK_4KB);
+}
+
+/*
+ * counts the present 4kb mappings in [start, end), only walking the tables
+ * that exist. Large pages aren't counted, wilde never creates them.
+ */
+size_t pt_count_mapped(uintptr_t start, uintptr_t end)
+{
+  p1_t *p1 = (p1_t *)rcr3(true);
+  size_t mapped = 0;
+
+  for (uintptr_t vaddr = ROUNDDOWN(start, 1ULL << PT_P3_VA_SHIFT); vaddr < end;) {
+    p2_t *p2 = pt_next(p1, PT_P1_IDX(vaddr), PT_P1_PRESENT, false);
+    if (!p2) {
+      vaddr = ROUNDDOWN(vaddr, 1ULL << PT_P1_VA_SHIFT) + (1ULL << PT_P1_VA_SHIFT);
+      continue;
+    }
 
-  size_t p1i = PT_P1_IDX((uintptr_t)to);
-  size_t p2i = PT_P2_IDX((uintptr_t)to);
-  size_t p3i = PT_P3_IDX((uintptr_t)to);
-  size_t p4i = PT_P4_IDX((uintptr_t)to);
+    p2_t p2_e = p2[PT_P2_IDX(vaddr)];
+    p3_t *p3 = p2_e & PT_P2_1GB ? NULL
+                                : pt_next(p2, PT_P2_IDX(vaddr), PT_P2_PRESENT, false);
+    if (!p3) {
+      vaddr = ROUNDDOWN(vaddr, 1ULL << PT_P2_VA_SHIFT) + (1ULL << PT_P2_VA_SHIFT);
+      continue;
+    }
 
-  UK_ASSERT(p1i < PT_P1_ENTRIES);
-  UK_ASSERT(p2i < PT_P1_ENTRIES);
-  UK_ASSERT(p3i < PT_P1_ENTRIES);
-  UK_ASSERT(p4i < PT_P1_ENTRIES);
+    p3_t p3_e = p3[PT_P3_IDX(vaddr)];
+    p4_t *p4 = p3_e & PT_P3_2MB ? NULL
+                                : pt_next(p3, PT_P3_IDX(vaddr), PT_P3_PRESENT, false);
+    if (p4)
+      for (uintptr_t p4i = 0; p4i < PT_P4_ENTRIES; p4i++) {
+        uintptr_t page = vaddr + (p4i << PT_P4_VA_SHIFT);
+        if (p4[p4i] & PT_P4_PRESENT && page >= start && page < end)
+          mapped++;
+      }
 
-  /* customised optimised page walking, auto create */
-  p1_t *p1 = (p1_t *)rcr3(true); /* read the cr3 register to get a base */
-  p2_t *p2 = pt_next(p1, p1i, PT_P1_PRESENT | PT_P1_WRITE, true);
-  p3_t *p3 = pt_next(p2, p2i, PT_P2_PRESENT | PT_P2_WRITE, true);
-  p4_t *p4 = pt_next(p3, p3i, PT_P3_PRESENT | PT_P3_WRITE, true);
-  // dprintf("p4: %p [p4[vaddr]=%zu]\n", p4, p4[p4i]);
+    vaddr += 1ULL << PT_P3_VA_SHIFT;
+  }
 
-  dprintf("mapping in %p = [%zu, %zu, %zu, %zu] <- %p\n",
-    to, p1i, p2i, p3i, p4i, from
-  );
-  for (size_t offset = 0; offset < size; offset += __PAGE_SIZE) {
-    // dprintf("mapping in %p = [%zu, %zu, %zu, %zu] <- %p\n",
-    //   to + offset, p1i, p2i, p3i, p4i, from + offset
-    // );
+  return mapped;
+}
 
+/*
+ * fills a fresh p4 table with the 512 pages from phys on, it isn't reachable
+ * until the caller installs it, so there's nothing to check or flush
+ */
+static uintptr_t pt_fill_p4(uintptr_t phys)
+{
+  p4_t *p4 = (p4_t *)pt_create();
 
-    UK_ASSERT(p1i < 512);
-    UK_ASSERT(p2i < 512);
-    UK_ASSERT(p3i < 512);
-    UK_ASSERT(p4i < 512);
+  for (size_t p4i = 0; p4i < PT_P4_ENTRIES; p4i++)
+    p4[p4i] = (phys + (p4i << PT_P4_VA_SHIFT)) | PT_P4_BITS_SET;
 
-    if (p4[p4i] & PT_P4_PRESENT)
-      UK_CRASH("WILDE CRIT: Tried to remap %p to %p but it already pointed to phys %llx\n",
-        from + offset, to + offset, p4[p4i] & PT_MASK_ADDR
-      );
+  return (uintptr_t)p4;
+}
 
-    // UK_ASSERT(!p4[p4i]);
+/* same as pt_fill_p4 for the GB from phys on, one level up */
+static uintptr_t pt_fill_p3(uintptr_t phys)
+{
+  p3_t *p3 = (p3_t *)pt_create();
 
+  for (size_t p3i = 0; p3i < PT_P3_ENTRIES; p3i++)
+    p3[p3i] = pt_fill_p4(phys + (p3i << PT_P3_VA_SHIFT)) | PT_P3_PRESENT | PT_P3_WRITE;
 
-    /* write the new entry in p4 table, pointing to previous memory */
-    p4[p4i] = (p4_t)(from + offset) | PT_P4_BITS_SET;
+  return (uintptr_t)p3;
+}
 
-    /* flush tlb cache for entry */
-    // tlbflush_phys(from + offset);
+/* drops a p3 table and the p4 tables below it, without looking at the pages */
+static void pt_drop_p3(p3_t *p3)
+{
+  for (size_t p3i = 0; p3i < PT_P3_ENTRIES; p3i++)
+    if (p3[p3i] & PT_P3_PRESENT)
+      pt_drop((uintptr_t *)(p3[p3i] & PT_MASK_ADDR));
 
-    /* avoid creation of 1 too many page table pages */
-    if (offset + __PAGE_SIZE >= size)
-      break;
+  pt_drop(p3);
+}
 
-    /* cascading updating */
-    p4i = (p4i + 1) % PT_P4_ENTRIES;
-    if (p4i == 0) {
-      p3i = (p3i + 1) % PT_P3_ENTRIES;
+void remap_range(void *from, void *to, size_t size)
+{
+  /* I'm lazy, assume from is phys */
+  PT_ASSERT_PHYS(from);
 
-      if (p3i == 0) {
-        p2i = (p2i + 1) % PT_P2_ENTRIES;
+  uintptr_t phys = (uintptr_t)from;
+  uintptr_t vaddr = (uintptr_t)to;
+  uintptr_t end = vaddr + ROUNDUP(size, __PAGE_SIZE);
 
-        if (p2i == 0) {
-          p1i++;
-          // dprintf("Updating p2: %p\n", p2);
-          p2 = pt_next(p1, p1i, PT_P1_PRESENT | PT_P1_WRITE, true);
-          // dprintf("New      p2: %p\n", p2);
-        }
+  dprintf("mapping in %p-%p <- %p\n", to, (void *)end, from);
 
-        // dprintf("Updating p3: %p\n", p3);
-        p3 = pt_next(p2, p2i, PT_P2_PRESENT | PT_P2_WRITE, true);
-        // dprintf("New      p3: %p\n", p3);
+  /* read the cr3 register to get a base */
+  p1_t *p1 = (p1_t *)rcr3(true);
 
-      }
+  while (vaddr < end) {
+    p2_t *p2 = pt_next(p1, PT_P1_IDX(vaddr), PT_P1_PRESENT | PT_P1_WRITE, true);
+    size_t p2i = PT_P2_IDX(vaddr);
 
-      // dprintf("Updating p4: %p\n", p4);
-      p4 = pt_next(p3, p3i, PT_P3_PRESENT | PT_P3_WRITE, true);
-      // dprintf("New      p4: %p\n", p4);
+    /* a whole GB nothing maps yet, build its tables aside and hook them in */
+    if ((vaddr & MASK_1GB) == 0 && end - vaddr > MASK_1GB &&
+        (p2[p2i] & PT_P2_PRESENT) == 0) {
+      p2[p2i] = pt_fill_p3(phys) | PT_P2_PRESENT | PT_P2_WRITE;
+      vaddr += MASK_1GB + 1;
+      phys += MASK_1GB + 1;
+      continue;
+    }
+
+    p3_t *p3 = pt_next(p2, p2i, PT_P2_PRESENT | PT_P2_WRITE, true);
+    size_t p3i = PT_P3_IDX(vaddr);
+
+    /* same for a whole 2MB */
+    if ((vaddr & MASK_2MB) == 0 && end - vaddr > MASK_2MB &&
+        (p3[p3i] & PT_P3_PRESENT) == 0) {
+      p3[p3i] = pt_fill_p4(phys) | PT_P3_PRESENT | PT_P3_WRITE;
+      vaddr += MASK_2MB + 1;
+      phys += MASK_2MB + 1;
+      continue;
+    }
+
+    /* an edge, or a table someone else maps into already, page by page */
+    p4_t *p4 = pt_next(p3, p3i, PT_P3_PRESENT | PT_P3_WRITE, true);
+
+    for (size_t p4i = PT_P4_IDX(vaddr); p4i < PT_P4_ENTRIES && vaddr < end;
+         p4i++, vaddr += __PAGE_SIZE, phys += __PAGE_SIZE) {
+      if (p4[p4i] & PT_P4_PRESENT)
+        UK_CRASH("WILDE CRIT: Tried to remap %lx to %lx but it already pointed to phys %llx\n",
+          phys, vaddr, p4[p4i] & PT_MASK_ADDR
+        );
+
+      /* write the new entry in p4 table, pointing to previous memory */
+      p4[p4i] = (p4_t)phys | PT_P4_BITS_SET;
     }
   }
 
-  dprintf("until in %p = [%zu, %zu, %zu, %zu] <- %p\n",
-    to + ROUNDUP(size, __PAGE_SIZE), p1i, p2i, p3i, p4i, from + ROUNDUP(size, __PAGE_SIZE)
-  );
+  STAT_ADD(ptes_set, ROUNDUP(size, __PAGE_SIZE) / __PAGE_SIZE);
 
 #ifdef CONFIG_LIBWILDE_TEST
   /* test if memory mapped correctly */
@@ -365,116 +613,173 @@ void remap_range(void *from, void *to, size_t size)
 }
 
 
-void unmap_range(void *addr, size_t size)
+static void unmap_range_internal(void *addr, size_t size, bool flush)
 {
   dprintf("unmapping range %p-%p\n", addr, addr + size);
 
-  /*****************************************************************
-   * Setting up the initial data points to work with
-   ****************************************************************/
+  uintptr_t vaddr = (uintptr_t)addr;
+  uintptr_t end = vaddr + ROUNDUP(size, __PAGE_SIZE);
 
-  /* calculate the indices in page table levels 1,2,3,4 - integer calculation */
-  size_t p1i = PT_P1_IDX((uintptr_t) addr);
-  size_t p2i = PT_P2_IDX((uintptr_t) addr);
-  size_t p3i = PT_P3_IDX((uintptr_t) addr);
-  size_t p4i = PT_P4_IDX((uintptr_t) addr);
+  /* whether whole tables went, those are flushed at once at the end */
+  bool dropped = false;
 
-  /* calculate the start of every page table - expensive page table lookup */
-  p1_t *p1 = (p1_t *)rcr3(true);
-  p2_t *p2 = pt_next(p1, p1i, PT_P1_PRESENT, false);
-  p3_t *p3 = pt_next(p2, p2i, PT_P2_PRESENT, false);
-  p4_t *p4 = pt_next(p3, p3i, PT_P3_PRESENT, false);
+  /* whether the current p3 table lost an entry */
+  bool lost = false;
 
-  /* assert we can reach p2, p3, p4 */
-  UK_ASSERT(p2);
-  UK_ASSERT(p3);
-  UK_ASSERT(p4);
+  p1_t *p1 = (p1_t *)rcr3(true);
 
-  uintptr_t paddr;
+  STAT_ADD(ptes_cleared, ROUNDUP(size, __PAGE_SIZE) / __PAGE_SIZE);
+
+  /*
+   * Walks the range a p4 table at a time. Tables the range covers entirely are
+   * freed as they are, without clearing the 512 (or 262144) entries below them
+   * first, nothing else can be mapped in there. Only the edges are unmapped
+   * page by page, after which their table is freed if it ended up empty.
+   *
+   * Emptied p4 tables can empty their p3 table, which is then freed as well,
+   * p2 tables stay, there are only a handful in the window.
+   */
+  while (vaddr < end) {
+    size_t p2i = PT_P2_IDX(vaddr);
+    size_t p3i = PT_P3_IDX(vaddr);
+
+    p2_t *p2 = pt_next(p1, PT_P1_IDX(vaddr), PT_P1_PRESENT, false);
+    p3_t *p3 = pt_next(p2, p2i, PT_P2_PRESENT, false);
+    UK_ASSERT(p2);
+    UK_ASSERT(p3);
+
+    /* a whole GB, drop the p3 table with everything below it */
+    if ((vaddr & MASK_1GB) == 0 && end - vaddr > MASK_1GB) {
+      p2[p2i] = 0;
+      pt_drop_p3(p3);
+      dropped = true;
+      vaddr += MASK_1GB + 1;
+      continue;
+    }
 
-  /******************************************************************
-   * Main loop over all the addresses to unmap
-   *****************************************************************/
-  for (size_t offset = 0; offset < size; offset += __PAGE_SIZE) {
-    uintptr_t vaddr = (uintptr_t)(addr + offset); /* address to unmap */
+    p4_t *p4 = pt_next(p3, p3i, PT_P3_PRESENT, false);
+    UK_ASSERT(p4);
+
+    if ((vaddr & MASK_2MB) == 0 && end - vaddr > MASK_2MB) {
+      /* a whole 2MB, drop the p4 table */
+      p3[p3i] = 0;
+      pt_drop(p4);
+      dropped = lost = true;
+      vaddr += MASK_2MB + 1;
+    } else {
+      for (size_t p4i = PT_P4_IDX(vaddr); p4i < PT_P4_ENTRIES && vaddr < end;
+           p4i++, vaddr += __PAGE_SIZE) {
+        if ((p4[p4i] & PT_P4_PRESENT) == 0)
+          UK_CRASH("Could not unmap %lx, it's not mapped in\n", vaddr);
+
+        /* unmap the page */
+        p4[p4i] = ~PT_P4_PRESENT;
+
+        /* no trace of the page may be left behind in the TLB */
+        if (flush)
+          shootdown_page(vaddr);
+      }
 
-    if ((p4[p4i] & PT_P4_PRESENT) == 0)
-      UK_CRASH("Could not unmap %lx, it's not mapped in\n", vaddr);
+      lost |= pt_try_remove(&p3[p3i], p4);
+    }
 
-    UK_ASSERT(p1i < 512);
-    UK_ASSERT(p2i < 512);
-    UK_ASSERT(p3i < 512);
-    UK_ASSERT(p4i < 512);
+    /*
+     * on the way out of a p3 table that lost an entry, only for large ranges,
+     * small ones would free and recreate the p3 table they're in all the time
+     */
+    if (lost && dropped && ((vaddr & MASK_1GB) == 0 || vaddr >= end)) {
+      pt_try_remove(&p2[p2i], p3);
+      lost = false;
+    }
+  }
 
-    paddr = p4[p4i] & PT_MASK_ADDR;
+  if (!flush)
+    return;
 
-    /* unmap the page */
-    p4[p4i] = ~PT_P4_PRESENT;
+  /* the tables dropped are gone, a single flush takes their pages along */
+  if (dropped)
+    shootdown_all();
+  shootdown_finish();
+  pt_free_dropped();
+}
 
-    /*
-     * Now we need to go to the next page mapping, doing so is slightly
-     * complicated.
-     *
-     * if we haven't run out of p4 table yet it's just a simple p4i++
-     * otherwise we have to
-     *
-     * - find the next p2, p3 and p4 tables (in case p2i, p3i or p4i leapt over the boundary)
-     * - possibly free the previous p3 and p4 tables (if they ended up empty)
-     *   -> and update the tables pointing to them
-     *  note that we need to nest these to not perform extra checks when they're not necessary
-     *
-     * Ideally this would be in seperate functions... but
-     * a) pointers to pointers (pointing to pointers... etc) only get more confusing
-     * b) this wouldn't be as performant
-     * c) the code would still be a mess, some spaghetti required, just like the rest during COVID times :/
-     */
-    p4i = (p4i + 1) % PT_P4_ENTRIES;
-
-    /* if we need to go to the next p4 table */
-    if (p4i == 0) {
-      if (pt_try_remove(&p3[p3i], p4)) {
-        dprintf("p4 mapping %p-%p no longer has any mappings, removed\n",
-          (void *)(ADDR_FROM_IDX(p1i, p2i, p3i, 0)),
-          (void *)(ADDR_FROM_IDX(p1i, p2i, p3i, PT_P4_ENTRIES))
-        );
-      }
+void unmap_range(void *addr, size_t size)
+{
+  unmap_range_internal(addr, size, true);
+}
 
-      p3i = (p3i + 1) % PT_P3_ENTRIES;  /* update p3i index */
+void unmap_range_noflush(void *addr, size_t size)
+{
+  unmap_range_internal(addr, size, false);
+}
 
-      /* if we need to go to the next p3 table */
-      if (p3i == 0) {
-        if (pt_try_remove(&p2[p2i], p3)) {
-          dprintf("p3 mapping %p-%p no longer has any mappings, removed\n",
-            (void *)(ADDR_FROM_IDX(p1i, p2i, 0, 0)),
-            (void *)(ADDR_FROM_IDX(p1i, p2i, PT_P3_ENTRIES, 0))
-          );
-        }
+void unmap_range_detach(void *addr, size_t size,
+                        void (*detached)(uintptr_t table, size_t covered))
+{
+  dprintf("detaching range %p-%p\n", addr, addr + size);
 
-        p2i = (p2i + 1) % PT_P2_ENTRIES;  /* update p2i index */
+  uintptr_t vaddr = (uintptr_t)addr;
+  uintptr_t end = vaddr + size;
+  p1_t *p1 = (p1_t *)rcr3(true);
 
-        /* if we need to go to the next p2 table */
-        if (p2i == 0) {
-          p1i++;
-          p2 = pt_next(p1, p1i, PT_P1_PRESENT, false);
-        }
+  while (vaddr < end) {
+    p2_t *p2 = pt_next(p1, PT_P1_IDX(vaddr), PT_P1_PRESENT, false);
+    UK_ASSERT(p2);
 
-        p3 = pt_next(p2, p2i, PT_P2_PRESENT, false);
-      }
+    /* a whole GB, cut off at the p2 entry */
+    if ((vaddr & MASK_1GB) == 0 && end - vaddr > MASK_1GB) {
+      p2_t *p2_e = &p2[PT_P2_IDX(vaddr)];
+      UK_ASSERT(*p2_e & PT_P2_PRESENT);
 
-      p4 = pt_next(p3, p3i, PT_P3_PRESENT, false);
+      detached(*p2_e & PT_MASK_ADDR, MASK_1GB + 1);
+      *p2_e = 0;
+      vaddr += MASK_1GB + 1;
+      continue;
     }
-    /* if this is the last iteration */
-    else if (offset + __PAGE_SIZE >= size) {
-      pt_try_remove(&p3[p3i], p4);
+
+    size_t p2i = PT_P2_IDX(vaddr);
+    p3_t *p3 = pt_next(p2, p2i, PT_P2_PRESENT, false);
+    UK_ASSERT(p3);
+
+    if ((vaddr & MASK_2MB) == 0 && end - vaddr > MASK_2MB) {
+      /* a whole 2MB, cut off at the p3 entry */
+      p3_t *p3_e = &p3[PT_P3_IDX(vaddr)];
+      UK_ASSERT(*p3_e & PT_P3_PRESENT);
+
+      detached(*p3_e & PT_MASK_ADDR, MASK_2MB + 1);
+      *p3_e = 0;
+      vaddr += MASK_2MB + 1;
+    } else {
+      /* an edge, page by page up to the next 2MB */
+      size_t edge = MIN(end - vaddr, ROUNDUP(vaddr + 1, MASK_2MB + 1) - vaddr);
+      unmap_range_noflush((void *)vaddr, edge);
+      vaddr += edge;
     }
 
-    /*
-     * we need to flush the physical address after unmapping it to ensure
-     * no trace get's left behind in the TLB.
-     *
-     * This is put at the end so that if we remove page tables, those changes will be
-     * included in the INVLPG instruction.
-     */
-    tlbflush_phys(paddr);
+    /* leaving a p3 table, unmap_range_noflush may have removed it already */
+    if (((vaddr & MASK_1GB) == 0 || vaddr >= end) && (p2[p2i] & PT_P2_PRESENT))
+      pt_try_remove(&p2[p2i], p3);
   }
 }
+
+bool pt_release_detached(uintptr_t table, size_t covered, u64 deadline)
+{
+  uintptr_t *pgtable = (uintptr_t *)table;
+  PT_ASSERT_PHYS(pgtable);
+
+  /* a p3 table, its entries are p4 tables whose entries are left as they are */
+  if (covered > MASK_2MB + 1)
+    for (int i = 0; i < PT_P3_ENTRIES; i++) {
+      if ((pgtable[i] & PT_P3_PRESENT) == 0)
+        continue;
+
+      pt_free((uintptr_t *)(pgtable[i] & PT_MASK_ADDR));
+      pgtable[i] = 0;
+
+      if (rdtsc() >= deadline)
+        return false;
+    }
+
+  pt_free(pgtable);
+  return true;
+}
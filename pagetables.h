@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <uk/alloc.h>
+#include <wilde.h>
 #include "util.h"
 
 #ifndef __x86_64__
@@ -76,6 +77,19 @@
     )
 
 
+/*
+ * Page tables and the memory they alias are expected in the identity mapped
+ * first GB. The host build keeps them in its simulated physical memory.
+ */
+#ifdef WILDE_HOST
+extern uintptr_t host_phys_start, host_phys_end;
+#define PT_IS_PHYS(Addr)                                                       \
+  ((uintptr_t)(Addr) >= host_phys_start && (uintptr_t)(Addr) < host_phys_end)
+#else
+#define PT_IS_PHYS(Addr) ((uintptr_t)(Addr) < (1 * GB))
+#endif
+#define PT_ASSERT_PHYS(Addr) UK_ASSERT(PT_IS_PHYS(Addr))
+
 #define MASK_1GB 0x3fffffff
 #define MASK_2MB 0x1fffff
 #define MASK_4KB 0xfff
@@ -83,8 +97,56 @@
 /* debug dump */
 void print_pgtables(bool skip_first_gb);
 
-/* range remapping and unmapping */
+/* structured counts of the page tables, for monitoring */
+void wilde_pt_census(struct wilde_pt_census *out);
+
+/* single page lookup, 0 when not mapped */
+uintptr_t pt_get_phys(uintptr_t vaddr);
+
+/* present 4kb mappings in [start, end) */
+size_t pt_count_mapped(uintptr_t start, uintptr_t end);
+
+/* frees the empty page tables of the alias window, returns how many */
+size_t pt_sweep(void);
+
+/*
+ * range remapping and unmapping, tables a range covers entirely are filled
+ * before they're hooked in and freed without clearing their entries
+ */
 void remap_range(void *from, void *to, size_t size);
 void unmap_range(void *addr, size_t size);
 
+/*
+ * unmap_range without flushing a single page, for tearing down a large range
+ * at once, the caller does one shootdown_all(), shootdown_finish() and
+ * pt_free_dropped() after
+ */
+void unmap_range_noflush(void *addr, size_t size);
+
+/*
+ * gives back the page tables unmapping dropped, only once shootdown_finish()
+ * made sure no CPU walks through them anymore
+ */
+void pt_free_dropped(void);
+
+/*
+ * revokes access to [addr, addr + size) without going through every page.
+ * Whole 1GB and 2MB stretches are cut off at the entry pointing to their p3
+ * or p4 table, the table is handed to detached() with the bytes it covered
+ * and left as it is. Only the edges are unmapped page by page. Doesn't flush,
+ * the caller does one shootdown_all(), shootdown_finish() and
+ * pt_free_dropped() after.
+ */
+void unmap_range_detach(void *addr, size_t size,
+                        void (*detached)(uintptr_t table, size_t covered));
+
+/*
+ * frees a table unmap_range_detach handed out and the tables below it, the
+ * pages they mapped are left alone. Stops once the tsc passes deadline,
+ * after freeing at least one table, and can be called again to continue
+ *
+ * returns whether table itself was freed, i.e. whether it's done
+ */
+bool pt_release_detached(uintptr_t table, size_t covered, u64 deadline);
+
 #endif // __WILDE_PGTABLES_H__
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef __WILDE_PERCPU_H__
+#define __WILDE_PERCPU_H__
+#include "util.h"
+
+/*
+ * Per CPU data is kept in arrays of WILDE_NR_CPUS entries, indexed by
+ * wilde_cpu_id(). Every CPU only writes its own entry, so no locks or atomics
+ * are required, readers sum up the entries.
+ *
+ * Under CONFIG_LIBWILDE_SMP a CPU's id plus one lives in its IA32_TSC_AUX
+ * MSR, which wilde_smp_cpu_online() sets, and is read back with RDPID, or
+ * RDTSCP on CPUs without it. A CPU that was never brought online reads 0 and
+ * runs as CPU 0, see shootdown_enter(). Otherwise wilde runs on a single core.
+ */
+#ifdef CONFIG_LIBWILDE_SMP
+#define WILDE_NR_CPUS CONFIG_LIBWILDE_NR_CPUS
+
+#ifdef WILDE_HOST
+/* the simulated CPU's id plus one, see host/host.c */
+extern unsigned host_cpu;
+
+static inline unsigned wilde_cpu_tag(void)
+{
+  return host_cpu;
+}
+
+static inline void wilde_cpu_set_id(unsigned cpu)
+{
+  host_cpu = cpu + 1;
+}
+#else
+#define MSR_TSC_AUX 0xC0000103
+
+static inline unsigned wilde_cpu_tag(void)
+{
+  static int has_rdpid = -1;
+  u64 tag;
+
+  /* cpuid traps to the hypervisor, so it's only asked once */
+  if (has_rdpid < 0) {
+    u32 eax = 7, ebx, ecx = 0, edx;
+    __asm __volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    has_rdpid = !!(ecx & POW2(22));
+  }
+
+  if (has_rdpid) {
+    __asm __volatile("rdpid %0" : "=r"(tag));
+  } else {
+    u32 low, high, aux;
+    __asm __volatile("rdtscp" : "=a"(low), "=d"(high), "=c"(aux));
+    tag = aux;
+  }
+
+  return tag;
+}
+
+static inline void wilde_cpu_set_id(unsigned cpu)
+{
+  __asm __volatile("wrmsr" : : "a"(cpu + 1), "d"(0), "c"(MSR_TSC_AUX));
+}
+#endif /* WILDE_HOST */
+
+/* CPUs never brought online run as CPU 0 */
+static inline unsigned wilde_cpu_id(void)
+{
+  unsigned tag = wilde_cpu_tag();
+
+  return tag ? tag - 1 : 0;
+}
+
+#else
+#define WILDE_NR_CPUS 1
+
+static inline unsigned wilde_cpu_id(void)
+{
+  return 0;
+}
+#endif /* CONFIG_LIBWILDE_SMP */
+
+#define PERCPU(Array) ((Array)[wilde_cpu_id()])
+
+#endif /* __WILDE_PERCPU_H__ */
@@ -0,0 +1,175 @@
+#define COLOR COLOR_WHITE
+
+#include <uk/assert.h>
+#include <uk/print.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "policy.h"
+#include "util.h"
+
+/* two sets of tables, loads fill the one not in use */
+static struct policy policies[2];
+struct policy *policy_active = &policies[0];
+
+/* loads are serialised among each other, lookups never wait for it */
+static int policy_lock;
+
+static void policy_lock_take(void)
+{
+  while (__atomic_exchange_n(&policy_lock, 1, __ATOMIC_ACQUIRE))
+    __builtin_ia32_pause();
+}
+
+static void policy_lock_drop(void)
+{
+  __atomic_store_n(&policy_lock, 0, __ATOMIC_RELEASE);
+}
+
+static const char *const policy_mode_names[] = {
+  [WILDE_MODE_ALIAS]       = "alias",
+  [WILDE_MODE_GUARD]       = "guard",
+  [WILDE_MODE_SAMPLED]     = "sample",
+  [WILDE_MODE_PASSTHROUGH] = "pass",
+};
+
+#define POLICY_NR_MODES (sizeof(policy_mode_names) / sizeof(policy_mode_names[0]))
+
+/* fills in p from the rules, 0 or an error */
+static int policy_build(struct policy *p, const struct wilde_policy_rule *rules,
+                        size_t nr_rules, enum wilde_mode default_mode)
+{
+  struct policy_site *sites = p->sites;
+  unsigned nr_sites = 0;
+
+  memset(sites, 0, sizeof(p->sites));
+  for (int i = 0; i < POLICY_SIZE_CLASSES; i++)
+    p->size[i] = default_mode;
+
+  for (size_t r = 0; r < nr_rules; r++) {
+    const struct wilde_policy_rule *rule = &rules[r];
+
+    if ((unsigned)rule->mode >= POLICY_NR_MODES)
+      return -EINVAL;
+
+    if (rule->caller) {
+      if (nr_sites == POLICY_MAX_SITES)
+        return -ENOSPC;
+
+      uintptr_t i = hash_address(rule->caller);
+      while (sites[i % POLICY_SITES].caller &&
+             sites[i % POLICY_SITES].caller != rule->caller)
+        i++;
+
+      if (!sites[i % POLICY_SITES].caller)
+        nr_sites++;
+
+      sites[i % POLICY_SITES] = (struct policy_site){.caller = rule->caller,
+                                                     .mode = rule->mode};
+      continue;
+    }
+
+    if (rule->min_size > rule->max_size)
+      return -EINVAL;
+
+    /* size ranges are rounded out to whole size classes */
+    for (int c = LOG2(rule->min_size | 1); c <= LOG2(rule->max_size | 1); c++)
+      p->size[c] = rule->mode;
+  }
+
+  p->nr_sites = nr_sites;
+  return 0;
+}
+
+int wilde_policy_load(const struct wilde_policy_rule *rules, size_t nr_rules,
+                      enum wilde_mode default_mode)
+{
+  if ((unsigned)default_mode >= POLICY_NR_MODES)
+    return -EINVAL;
+
+  policy_lock_take();
+
+  /* a bad rule leaves the tables in use alone */
+  struct policy *next = &policies[policy_active == &policies[0]];
+  int res = policy_build(next, rules, nr_rules, default_mode);
+  if (!res) {
+    __atomic_store_n(&policy_active, next, __ATOMIC_RELEASE);
+    dprintf("Loaded %zu policy rules, %u call sites\n", nr_rules,
+            next->nr_sites);
+  }
+
+  policy_lock_drop();
+  return res;
+}
+
+int wilde_policy_parse(const char *rules, enum wilde_mode default_mode)
+{
+  struct wilde_policy_rule parsed[POLICY_MAX_RULES];
+  size_t nr_rules = 0;
+  const char *p = rules;
+  char *end;
+
+  while (*p) {
+    struct wilde_policy_rule rule = {0};
+
+    if (!strncmp(p, "size:", 5)) {
+      rule.min_size = strtoull(p + 5, &end, 0);
+      if (*end != '-')
+        return -EINVAL;
+
+      p = end + 1;
+      rule.max_size = *p == '=' ? SIZE_MAX : strtoull(p, &end, 0);
+      if (*p != '=')
+        p = end;
+    } else if (!strncmp(p, "caller:", 7)) {
+      rule.caller = strtoull(p + 7, &end, 0);
+      if (!rule.caller)
+        return -EINVAL;
+
+      p = end;
+    } else {
+      return -EINVAL;
+    }
+
+    if (*p++ != '=')
+      return -EINVAL;
+
+    unsigned m;
+    for (m = 0; m < POLICY_NR_MODES; m++) {
+      size_t len = strlen(policy_mode_names[m]);
+      if (!strncmp(p, policy_mode_names[m], len) && (p[len] == ',' || !p[len]))
+        break;
+    }
+
+    if (m == POLICY_NR_MODES)
+      return -EINVAL;
+
+    p += strlen(policy_mode_names[m]);
+    if (*p == ',')
+      p++;
+
+    if (nr_rules == POLICY_MAX_RULES)
+      return -ENOSPC;
+
+    rule.mode = (enum wilde_mode)m;
+    parsed[nr_rules++] = rule;
+  }
+
+  return wilde_policy_load(parsed, nr_rules, default_mode);
+}
+
+void policy_init(void)
+{
+#ifdef CONFIG_LIBWILDE_SAMPLING
+  enum wilde_mode default_mode = WILDE_MODE_SAMPLED;
+#else
+  enum wilde_mode default_mode = WILDE_MODE_ALIAS;
+#endif
+
+  int res = wilde_policy_parse(CONFIG_LIBWILDE_POLICY_RULES, default_mode);
+  if (res) {
+    uk_pr_err("Invalid LIBWILDE_POLICY_RULES \"%s\" (%d), protecting everything\n",
+              CONFIG_LIBWILDE_POLICY_RULES, res);
+    wilde_policy_load(NULL, 0, default_mode);
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef __WILDE_POLICY_H__
+#define __WILDE_POLICY_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <wilde.h>
+#include "alias.h"
+#include "util.h"
+
+/*
+ * Protection policy, decides per allocation which wilde_mode it gets.
+ *
+ * Lookups have to be cheap as they're on every malloc, so:
+ *   - size rules are flattened into a mode per power of 2 size class, a
+ *     lookup is a LOG2 and a load
+ *   - call site rules live in a small open addressing table keyed on the
+ *     return address, kept at most half full so probes stay short. When there
+ *     are no call site rules, the stack isn't even looked at.
+ *
+ * Call site rules win over size rules.
+ *
+ * wilde_policy_load() builds the new tables in the set not in use and
+ * publishes it with a single pointer store, lookups take no lock. Only a
+ * lookup outlasting two loads in a row could see the tables it started on
+ * rewritten, it then gets some loaded mode, probes are bounded either way.
+ */
+
+#define POLICY_SIZE_CLASSES 64
+#define POLICY_SITES        256 /* power of 2 */
+#define POLICY_MAX_SITES    (POLICY_SITES / 2)
+#define POLICY_MAX_RULES    64  /* for parsing rule strings */
+
+struct policy_site {
+  uintptr_t caller;     /* 0 for an empty slot */
+  enum wilde_mode mode;
+};
+
+struct policy {
+  u8 size[POLICY_SIZE_CLASSES];
+  struct policy_site sites[POLICY_SITES];
+  unsigned nr_sites;
+};
+
+/* the tables in use */
+extern struct policy *policy_active;
+
+/* loads the LIBWILDE_POLICY_RULES boot rules */
+void policy_init(void);
+
+static inline const struct policy *policy_get(void)
+{
+  return __atomic_load_n(&policy_active, __ATOMIC_ACQUIRE);
+}
+
+static inline enum wilde_mode policy_lookup_size(const struct policy *p,
+                                                 size_t size)
+{
+  return (enum wilde_mode)p->size[LOG2(size | 1)];
+}
+
+/* returns whether there's a rule for caller, filling in mode if so */
+static inline bool policy_lookup_site(const struct policy *p, uintptr_t caller,
+                                      enum wilde_mode *mode)
+{
+  uintptr_t i = hash_address(caller);
+
+  for (unsigned n = 0; n < POLICY_SITES; n++, i++) {
+    const struct policy_site *s = &p->sites[i % POLICY_SITES];
+
+    if (s->caller == caller) {
+      *mode = s->mode;
+      return true;
+    }
+
+    if (!s->caller)
+      return false;
+  }
+
+  return false;
+}
+
+#endif /* __WILDE_POLICY_H__ */
@@ -0,0 +1,185 @@
+#define COLOR COLOR_WHITE
+
+#include <string.h>
+#include "profile.h"
+#include "alias.h"
+#include "util.h"
+
+struct profile_site profile_sites[PROFILE_SITES];
+size_t profile_countdown = CONFIG_LIBWILDE_PROFILE_INTERVAL;
+
+static size_t profile_interval = CONFIG_LIBWILDE_PROFILE_INTERVAL;
+static u64 profile_state = WILDE_SEED | 1;
+static u64 profile_dropped;
+
+/*
+ * Bytes until the next sample, -ln(u) * interval for u uniform in (0, 1].
+ * The log is done in 16.16 fixed point, exact at powers of 2 and linear in
+ * between, which is well within what a sampling profiler needs.
+ */
+static size_t profile_next_interval(void)
+{
+  if (profile_interval <= 1)
+    return 1;
+
+  /* xorshift64 */
+  profile_state ^= profile_state << 13;
+  profile_state ^= profile_state >> 7;
+  profile_state ^= profile_state << 17;
+
+  u64 u = (profile_state >> 38) + 1; /* [1, 2^26] */
+  int n = 63 - __builtin_clzll(u);
+  u64 log2_u = ((u64)n << 16) + ((u << 16 >> n) - (1 << 16));
+  u64 neg_log2 = (26ULL << 16) - log2_u;
+  u64 neg_ln = neg_log2 * 45426 >> 16; /* ln 2 = 45426 / 2^16 */
+
+  return (profile_interval * neg_ln >> 16) + 1;
+}
+
+static inline u64 alias_pages(uintptr_t alias, size_t size)
+{
+  return (ROUNDUP(alias + size, __PAGE_SIZE) - ROUNDDOWN(alias, __PAGE_SIZE)) /
+         __PAGE_SIZE;
+}
+
+static u64 hash_stack(void **stack, int depth)
+{
+  u64 h = depth;
+
+  for (int i = 0; i < depth; i++)
+    h = hash_address(h ^ (uintptr_t)stack[i]);
+
+  return h | 1;
+}
+
+/* finds or creates the site of stack, returns its tag or 0 if full */
+static u32 profile_site_get(void **stack, int depth)
+{
+  u64 h = hash_stack(stack, depth);
+
+  for (u32 i = 0; i < PROFILE_SITES; i++) {
+    u32 slot = (h + i) & (PROFILE_SITES - 1);
+    struct profile_site *p = &profile_sites[slot];
+
+    if (p->hash == h && p->s.depth == (unsigned)depth &&
+        !memcmp(p->s.stack, stack, depth * sizeof(*stack)))
+      return slot + 1;
+
+    if (p->hash == 0) {
+      p->hash = h;
+      p->s.depth = depth;
+      for (int d = 0; d < depth; d++)
+        p->s.stack[d] = (uintptr_t)stack[d];
+      return slot + 1;
+    }
+  }
+
+  return 0;
+}
+
+void profile_sample(uintptr_t alias, size_t size, void **stack, int depth)
+{
+  profile_countdown = profile_next_interval();
+
+  u32 tag = profile_site_get(stack, depth);
+  if (tag == 0) {
+    profile_dropped++;
+    return;
+  }
+
+  struct wilde_profile_site *s = &profile_sites[tag - 1].s;
+  s->alloc_objects++;
+  s->alloc_bytes += size;
+  s->live_objects++;
+  s->live_bytes += size;
+  s->live_pages += alias_pages(alias, size);
+
+  alias_tag(alias, tag);
+}
+
+void profile_free(const struct alias *a)
+{
+  struct wilde_profile_site *s = &profile_sites[a->tag - 1].s;
+
+  UK_ASSERT(s->live_objects);
+  s->live_objects--;
+  s->live_bytes -= a->size;
+  s->live_pages -= alias_pages(a->alias, a->size);
+}
+
+void profile_resize(const struct alias *a, size_t size)
+{
+  struct wilde_profile_site *s = &profile_sites[a->tag - 1].s;
+
+  s->live_bytes = s->live_bytes - a->size + size;
+  s->live_pages = s->live_pages - alias_pages(a->alias, a->size) +
+                  alias_pages(a->alias, size);
+}
+
+size_t wilde_profile_get(struct wilde_profile_site *buf, size_t max)
+{
+  size_t n = 0;
+
+  for (int i = 0; i < PROFILE_SITES && n < max; i++)
+    if (profile_sites[i].hash)
+      buf[n++] = profile_sites[i].s;
+
+  return n;
+}
+
+void wilde_profile_interval_set(size_t bytes)
+{
+  profile_interval = bytes ? bytes : 1;
+  profile_countdown = profile_next_interval();
+}
+
+size_t wilde_profile_interval_get(void)
+{
+  return profile_interval;
+}
+
+uint64_t wilde_profile_dropped(void)
+{
+  return profile_dropped;
+}
+
+/*
+ * Prints the profile in the legacy pprof heap format, which pprof reads
+ * together with the debug image, e.g.
+ *
+ *   pprof --text build/app_kvm-x86_64.dbg heap.txt
+ *
+ * Counts are as sampled, pprof scales them using the interval in the header.
+ */
+void wilde_profile_dump(void)
+{
+  u64 live_objects = 0, live_bytes = 0, alloc_objects = 0, alloc_bytes = 0;
+
+  for (int i = 0; i < PROFILE_SITES; i++) {
+    const struct wilde_profile_site *s = &profile_sites[i].s;
+    live_objects += s->live_objects;
+    live_bytes += s->live_bytes;
+    alloc_objects += s->alloc_objects;
+    alloc_bytes += s->alloc_bytes;
+  }
+
+  hprintf("heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%zu\n", live_objects,
+          live_bytes, alloc_objects, alloc_bytes, profile_interval);
+
+  for (int i = 0; i < PROFILE_SITES; i++) {
+    const struct wilde_profile_site *s = &profile_sites[i].s;
+    if (profile_sites[i].hash == 0)
+      continue;
+
+    char line[96 + 19 * PROFILE_DEPTH];
+    int len = snprintf(line, sizeof(line), "%lu: %lu [%lu: %lu] @",
+                       s->live_objects, s->live_bytes, s->alloc_objects,
+                       s->alloc_bytes);
+
+    for (unsigned d = 0; d < s->depth; d++)
+      len += snprintf(line + len, sizeof(line) - len, " %#lx", s->stack[d]);
+
+    line[len++] = '\n';
+    ukplat_coutk(line, len);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef __WILDE_PROFILE_H__
+#define __WILDE_PROFILE_H__
+#include <stdbool.h>
+#include <wilde.h>
+#include "alias.h"
+#include "util.h"
+
+/*
+ * Heap profiler, samples roughly one allocation per interval bytes.
+ *
+ * The distance to the next sample is drawn from an exponential distribution,
+ * the same as tcmalloc does, so pprof can scale the counts back up. Sampled
+ * allocations get the stack walked, hashed into the site table and their
+ * alias tagged with the site, so a free can be charged to the site that
+ * allocated. Everything is updated under the allocator lock.
+ */
+
+#ifdef CONFIG_LIBWILDE_PROFILE
+
+#define PROFILE_DEPTH WILDE_PROFILE_DEPTH
+#define PROFILE_SITES 1024 /* power of 2, tags are index + 1 */
+
+struct profile_site {
+  u64 hash; /* 0 for unused slots */
+  struct wilde_profile_site s;
+};
+
+extern struct profile_site profile_sites[PROFILE_SITES];
+extern size_t profile_countdown;
+
+/* the common path, counts down the bytes until the next sample */
+static inline bool profile_should_sample(size_t size)
+{
+  if (profile_countdown > size) {
+    profile_countdown -= size;
+    return false;
+  }
+
+  return true;
+}
+
+void profile_sample(uintptr_t alias, size_t size, void **stack, int depth);
+void profile_free(const struct alias *a);
+void profile_resize(const struct alias *a, size_t size);
+
+#define PROFILE_FREE(Alias)                                                    \
+  do {                                                                         \
+    if ((Alias)->tag)                                                          \
+      profile_free(Alias);                                                     \
+  } while (0)
+
+/* before the alias' size changes, so its site's live counts follow */
+#define PROFILE_RESIZE(Alias, Size)                                            \
+  do {                                                                         \
+    if ((Alias)->tag)                                                          \
+      profile_resize((Alias), (Size));                                         \
+  } while (0)
+
+#else
+
+#define PROFILE_FREE(Alias) do {} while (0)
+#define PROFILE_RESIZE(Alias, Size) do {} while (0)
+
+#endif /* CONFIG_LIBWILDE_PROFILE */
+
+#endif /* __WILDE_PROFILE_H__ */
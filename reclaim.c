@@ -0,0 +1,54 @@
+#define COLOR COLOR_GREEN
+
+#include <uk/assert.h>
+#include <uk/list.h>
+#include "reclaim.h"
+#include "pagetables.h"
+#include "vma.h"
+#include "shootdown.h"
+#include "stats.h"
+#include "util.h"
+#include "x86.h"
+
+static UK_LIST_HEAD(reclaim_queue);
+size_t reclaim_queued;
+
+static void reclaim_detached(uintptr_t table, size_t covered)
+{
+  struct vma *v = vma_alloc();
+  v->addr = table;
+  v->size = covered;
+
+  uk_list_add_tail(&v->list, &reclaim_queue);
+  reclaim_queued++;
+}
+
+void reclaim_unmap(uintptr_t addr, size_t size)
+{
+  dprintf("reclaim_unmap(%#lx, %zu), %zu tables queued\n", addr, size, reclaim_queued);
+
+  unmap_range_detach((void *)addr, size, reclaim_detached);
+  shootdown_all();
+  shootdown_finish();
+  pt_free_dropped();
+}
+
+void reclaim_step(u64 budget)
+{
+  u64 deadline = rdtsc() + budget;
+
+  while (!uk_list_empty(&reclaim_queue)) {
+    struct vma *v = uk_list_first_entry(&reclaim_queue, struct vma, list);
+
+    /* half way through a p3 table, it stays at the head */
+    if (!pt_release_detached(v->addr, v->size, deadline))
+      return;
+
+    uk_list_del(&v->list);
+    vma_free(v);
+    reclaim_queued--;
+
+    if (rdtsc() >= deadline)
+      return;
+  }
+}
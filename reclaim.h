@@ -0,0 +1,37 @@
+#ifndef __WILDE_RECLAIM_H__
+#define __WILDE_RECLAIM_H__
+#include <stdint.h>
+#include <stddef.h>
+#include "util.h"
+
+/*
+ * Incremental unmapping of huge frees.
+ *
+ * Unmapping a multi GB alias page by page blocks the free for milliseconds.
+ * Mappings of at least RECLAIM_THRESHOLD bytes are instead cut off where the
+ * page tables allow (see unmap_range_detach), which revokes access after a
+ * single TLB flush. The detached tables go on a queue, kept as struct vma's
+ * holding the table and the bytes it covered, and are freed in steps of at
+ * most CONFIG_LIBWILDE_RECLAIM_BUDGET cycles on later calls into wilde.
+ *
+ * Everything here expects the allocator lock to be held.
+ */
+
+#define RECLAIM_THRESHOLD (CONFIG_LIBWILDE_RECLAIM_THRESHOLD * MB)
+
+extern size_t reclaim_queued; /* detached tables waiting */
+
+/* revokes access to [addr, addr + size), queueing its tables */
+void reclaim_unmap(uintptr_t addr, size_t size);
+
+/* frees queued tables for about budget cycles, at least one if any */
+void reclaim_step(u64 budget);
+
+/* a step on the way, for the mapping paths */
+static inline void reclaim_tick(void)
+{
+  if (reclaim_queued)
+    reclaim_step(CONFIG_LIBWILDE_RECLAIM_BUDGET);
+}
+
+#endif /* __WILDE_RECLAIM_H__ */
@@ -30,6 +30,21 @@
 #define COLOR COLOR_YELLOW
 #include "util.h"
 #include "vma.h"
+#include "alias.h"
+#include "pagetables.h"
+#include "policy.h"
+#include "stats.h"
+#include "latency.h"
+#include "trace.h"
+#include "profile.h"
+#include "arena.h"
+#include "shootdown.h"
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+#include "magazine.h"
+#endif
+#ifdef CONFIG_LIBWILDE_RECLAIM
+#include "reclaim.h"
+#endif
 // }}}
 
 // macros {{{
@@ -38,7 +53,13 @@
   #include <uk/mutex.h>
 
   static struct uk_mutex global_mutex = UK_MUTEX_INITIALIZER(global_mutex);
-  #define alloc_lock()   do { uk_mutex_lock(&global_mutex); } while (0)
+
+  /* a CPU calling in is about to use aliases, it takes part in shootdowns */
+  #define alloc_lock()                                                         \
+    do {                                                                       \
+      uk_mutex_lock(&global_mutex);                                            \
+      shootdown_enter();                                                       \
+    } while (0)
   #define alloc_unlock() do { uk_mutex_unlock(&global_mutex); } while (0)
 #else
   #define alloc_lock() do {} while (0)
@@ -53,7 +74,12 @@
 #endif
 
 #ifdef CONFIG_LIBWILDE_INIT_MEMORY
-  #define CLEAR(Mem, Size) memset((Mem), CONFIG_LIBWILDE_INIT_MEMORY_VALUE, (Size));
+  #define CLEAR(Mem, Size)                                                     \
+    do {                                                                       \
+      LAT_BEGIN(__clear);                                                      \
+      memset((Mem), CONFIG_LIBWILDE_INIT_MEMORY_VALUE, (Size));                \
+      LAT_END(WILDE_PHASE_CLEAR, __clear);                                     \
+    } while (0)
 #else
   #define CLEAR(Mem, Size) do {} while (0)
 #endif
@@ -67,13 +93,11 @@
   #define kmalloc(Size)                        kallocs_malloc((Size))
   #define kcalloc(Nmemb, Size)                 kallocs_calloc((Nmemb), (Size))
   #define kmemalign(Align, Size)               kallocs_memalign((Align), (Size))
-  #define krealloc(Ptr, OldSize, NewSize)      kallocs_realloc((Ptr), (OldSize), (NewSize))
   #define kfree(Ptr, Size)                     kallocs_free((Ptr),(Size))
 #else
   #define kmalloc(Size)                        shimmed->malloc(shimmed, (Size))
   #define kcalloc(Nmemb, Size)                 shimmed->calloc(shimmed, (Nmemb), (Size))
-  #define kmemalign(Align, Size)               shimmed->memalign(shimmed, (Align), (Size))
-  #define krealloc(Ptr, OldSize, NewSize)      shimmed->realloc(shimmed, (Ptr), (NewSize))
+  #define kmemalign(Align, Size)               shimmed->memalign(shimmed, MIN((Align), __PAGE_SIZE), (Size))
   #define kfree(Ptr, Size)                     shimmed->free(shimmed, (Ptr))
 #endif
 // }}}
@@ -82,26 +106,439 @@
 struct uk_alloc *shimmed; /* the allocator on top of this */
 struct uk_alloc shim;     /* the shim itself, the new allocator */
 
+/*
+ * the frame that called the one at bp, NULL once the chain stops looking
+ * like one. Frames above the outermost one built with frame pointers hold
+ * whatever, so the next one has to be aligned, further up the stack, and
+ * within a stack of top, the frame the walk started from
+ */
+static inline __attribute__((always_inline)) void **frame_next(void **bp,
+                                                               void **top)
+{
+  void **next = *(void ***) bp;
+
+  if (next <= bp || (uintptr_t)next & (sizeof(void *) - 1) ||
+      (uintptr_t)next - (uintptr_t)top >= __STACK_SIZE)
+    return NULL;
+
+  return next;
+}
+
 /*
  * small function that allows for dumping the stack, based on rip being 1
  * above local vars
  */
-static inline void *get_caller_address(int level)
+static inline __attribute__((always_inline)) void *get_caller_address(int level)
 {
-  void **bp;
+  void **bp, **top, **next;
 
   asm("movq %%rbp, %0" : "=r"(bp));
+  top = bp;
 
-  while (level-- && *bp)
-    bp = *(void ***) bp;
+  while (level-- && (next = frame_next(bp, top)))
+    bp = next;
 
   return bp[1];
 }
 
+/*
+ * the same walk as get_caller_address, but keeping up to max return addresses
+ * starting at level skip, returns how many were found
+ */
+static inline __attribute__((always_inline)) int get_backtrace(void **buf,
+                                                               int skip, int max)
+{
+  void **bp, **top, **next;
+  int n = 0;
+
+  asm("movq %%rbp, %0" : "=r"(bp));
+  top = bp;
+
+  while (skip-- && (next = frame_next(bp, top)))
+    bp = next;
+
+  while (n < max && bp && bp[1]) {
+    buf[n++] = bp[1];
+    bp = frame_next(bp, top);
+  }
+
+  return n;
+}
+
+/* samples an aliased allocation for the heap profile, under the lock */
+#ifdef CONFIG_LIBWILDE_PROFILE
+  #define profile(Alias, Size)                                                 \
+    do {                                                                       \
+      if (profile_should_sample(Size)) {                                       \
+        void *__stack[PROFILE_DEPTH];                                          \
+        int __depth = get_backtrace(__stack, CONFIG_LIBWILDE_CALLER_DEPTH,     \
+                                    PROFILE_DEPTH);                            \
+        profile_sample((uintptr_t)(Alias), (Size), __stack, __depth);          \
+      }                                                                        \
+    } while (0)
+#else
+  #define profile(Alias, Size) do {} while (0)
+#endif
+
+/* records a call in the allocation trace */
+#ifdef CONFIG_LIBWILDE_TRACE
+  /* only used with the allocator lock dropped, a full ring may be flushed */
+  #define trace(Op, Size, Alias, Origin, Aux)                                  \
+    do {                                                                       \
+      trace_record((Op), (Size), (Alias), (Origin),                            \
+                   get_caller_address(CONFIG_LIBWILDE_CALLER_DEPTH), (Aux));   \
+      trace_flush_full();                                                      \
+    } while (0)
+#else
+  #define trace(...) do {} while (0)
+#endif
+
+// sampling {{{
+#ifdef CONFIG_LIBWILDE_SAMPLER
+/*
+ * Sampling mode, only every so many allocations get aliased. Rather than a
+ * fixed stride the distance to the next sampled allocation is drawn from
+ * [1, 2 * rate - 1], so on average 1 in rate is protected, but which one
+ * can't be predicted. The common path is just a decrement.
+ *
+ * It runs before the allocator lock is taken, so every CPU counts down and
+ * draws on its own, seeded apart the first time it samples.
+ */
+static unsigned sample_rate = CONFIG_LIBWILDE_SAMPLING_RATE;
+
+static struct {
+  unsigned countdown;
+  u64 state;
+} sample_cpus[WILDE_NR_CPUS] = {[0 ... WILDE_NR_CPUS - 1] = {.countdown = 1}};
+
+static unsigned sample_interval(void)
+{
+  unsigned rate = __atomic_load_n(&sample_rate, __ATOMIC_RELAXED);
+  u64 *state = &PERCPU(sample_cpus).state;
+
+  if (rate <= 1)
+    return 1;
+
+  if (!*state)
+    *state = hash_address(WILDE_SEED + wilde_cpu_id()) | 1;
+
+  /* xorshift64, only runs once per sampled allocation */
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+
+  return 1 + *state % (2 * rate - 1);
+}
+
+static inline bool shim_sample(void)
+{
+  unsigned *countdown = &PERCPU(sample_cpus).countdown;
+
+  if (--*countdown)
+    return false;
+
+  *countdown = sample_interval();
+  return true;
+}
+
+/* other CPUs move to the new rate with their next sample */
+void wilde_sample_rate_set(unsigned rate)
+{
+  __atomic_store_n(&sample_rate, rate ? rate : 1, __ATOMIC_RELAXED);
+  PERCPU(sample_cpus).countdown = sample_interval();
+}
+
+unsigned wilde_sample_rate_get(void)
+{
+  return __atomic_load_n(&sample_rate, __ATOMIC_RELAXED);
+}
+#else
+  #define shim_sample() (true)
+#endif
+// }}}
+
+// policy {{{
+/*
+ * shim_mode decides how an allocation of Size bytes gets protected, sampling
+ * already resolved, so it's one of alias, guard or passthrough.
+ *
+ * These are macros so get_caller_address walks the stack from the frame of
+ * the shim entry point itself.
+ */
+#ifdef CONFIG_LIBWILDE_POLICY
+  #define shim_policy(Size)                                                    \
+    ({                                                                         \
+      const struct policy *__p = policy_get();                                 \
+      enum wilde_mode __policy;                                                \
+      if (!__p->nr_sites ||                                                    \
+          !policy_lookup_site(__p, (uintptr_t)get_caller_address(             \
+            CONFIG_LIBWILDE_CALLER_DEPTH), &__policy))                         \
+        __policy = policy_lookup_size(__p, (Size));                            \
+      __policy;                                                                \
+    })
+#elif defined(CONFIG_LIBWILDE_SAMPLING)
+  #define shim_policy(Size) (WILDE_MODE_SAMPLED)
+#else
+  #define shim_policy(Size) (WILDE_MODE_ALIAS)
+#endif
+
+#define shim_mode(Size)                                                        \
+  ({                                                                           \
+    enum wilde_mode __mode = shim_policy((Size));                              \
+    if (__mode == WILDE_MODE_SAMPLED)                                          \
+      __mode = shim_sample() ? WILDE_MODE_ALIAS : WILDE_MODE_PASSTHROUGH;      \
+    __mode;                                                                    \
+  })
+
+#define shim_map_new(Mode, RealAddr, Size, Align)                              \
+  ((Mode) == WILDE_MODE_GUARD ? wilde_map_new_guard((RealAddr), (Size), (Align)) \
+                              : wilde_map_new((RealAddr), (Size), (Align)))
+// }}}
+
+// pressure {{{
+#ifdef CONFIG_LIBWILDE_PRESSURE
+#if !CONFIG_LIBUKALLOC_IFSTATS
+  #error "Memory pressure is told by availmem, it needs LIBUKALLOC_IFSTATS"
+#endif
+/*
+ * Memory pressure. What wilde holds on to without anyone using it goes back:
+ * prepared objects of magazines and caches, page tables queued for reclaim or
+ * left empty, and metadata batches none of the structs of are used. Once when
+ * availmem drops below CONFIG_LIBWILDE_PRESSURE_LOW MB, after which nothing is
+ * prepared until it's back above twice that, and whenever the backing
+ * allocator fails, before trying again.
+ */
+#define PRESSURE_LOW ((ssize_t)CONFIG_LIBWILDE_PRESSURE_LOW * MB)
+
+static bool pressure_low;
+
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+static void magazine_drain(void);
+#endif
+#ifdef CONFIG_LIBWILDE_CACHE
+static void cache_drain(void);
+#endif
+
+/* gives back what can be, returns the bytes availmem went up by */
+static size_t pressure_relieve(void)
+{
+  ssize_t before = shimmed->availmem(shimmed);
+
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+  magazine_drain();
+#endif
+#ifdef CONFIG_LIBWILDE_CACHE
+  cache_drain();
+#endif
+
+  alloc_lock();
+#ifdef CONFIG_LIBWILDE_RECLAIM
+  while (reclaim_queued)
+    reclaim_step(UINT64_MAX / 2);
+#endif
+  pt_sweep();
+  vma_shrink();
+  alias_shrink();
+  alloc_unlock();
+
+  ssize_t after = shimmed->availmem(shimmed);
+  alloc_printf("pressure => %zd bytes released\n", after - before);
+  return after > before ? after - before : 0;
+}
+
+/* relieves the pressure once on the way down past PRESSURE_LOW */
+static inline void pressure_check(void)
+{
+  ssize_t avail = shimmed->availmem(shimmed);
+
+  if (avail < 0)
+    return;
+
+  if (!pressure_low && avail < PRESSURE_LOW) {
+    pressure_low = true;
+    pressure_relieve();
+  } else if (pressure_low && avail >= 2 * PRESSURE_LOW) {
+    pressure_low = false;
+  }
+}
+
+/*
+ * a backing allocation, checking the pressure before and relieving it and
+ * trying once more when it fails
+ */
+#define kretry(Expr)                                                           \
+  ({                                                                           \
+    pressure_check();                                                          \
+    void *__mem = (Expr);                                                      \
+    if (__mem == NULL && pressure_relieve())                                   \
+      __mem = (Expr);                                                          \
+    __mem;                                                                     \
+  })
+
+size_t wilde_pressure(void)
+{
+  return pressure_relieve();
+}
+#else
+#define pressure_low false
+#define kretry(Expr) (Expr)
+#endif
+// }}}
+
+// magazines {{{
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+#ifndef CONFIG_LIBWILDE_LOCKING
+  #error "Magazines are refilled from a thread of their own, they need LIBWILDE_LOCKING"
+#endif
+#include <uk/sched.h>
+
+static bool magazine_thread_started;
+
+/* hands back an object of a magazine */
+static void magazine_teardown(void *obj)
+{
+  size_t size;
+
+  alloc_lock();
+  void *real_addr = wilde_map_rm(obj, &size);
+  alloc_unlock();
+
+  UK_ASSERT(real_addr);
+  kfree(real_addr, size);
+}
+
+/* tops m up to magazine_depth, after emptying it if its class went cold */
+static void magazine_refill(struct magazine *m)
+{
+  for (;;) {
+    void *obj = NULL;
+
+    alloc_lock();
+    if (m->class != m->want && m->count) {
+      obj = m->objs[--m->count];
+      STAT_MAGAZINE(-1);
+    } else {
+      m->class = m->want;
+    }
+    alloc_unlock();
+
+    if (obj == NULL)
+      break;
+    magazine_teardown(obj);
+  }
+
+  while (m->class && m->count < magazine_depth && !pressure_low) {
+    unsigned class = m->class;
+    size_t size = magazine_class_size(class);
+
+    void *real_addr = kmalloc(size);
+    if (real_addr == NULL)
+      return;
+
+    alloc_lock();
+    void *alias_addr = wilde_map_new(real_addr, size, __PAGE_SIZE);
+    alloc_unlock();
+
+    CLEAR(alias_addr, size);
+
+    /* the class might have gone cold in the meantime */
+    alloc_lock();
+    bool kept = m->class == class && m->count < magazine_depth;
+    if (kept) {
+      m->objs[m->count++] = alias_addr;
+      STAT_MAGAZINE(1);
+    }
+    alloc_unlock();
+
+    if (!kept)
+      magazine_teardown(alias_addr);
+  }
+}
+
+#ifdef CONFIG_LIBWILDE_PRESSURE
+/* empties every magazine, their classes stay hot */
+static void magazine_drain(void)
+{
+  for (unsigned i = 0; i < MAGAZINE_HOT; i++) {
+    struct magazine *m = &magazines[i];
+
+    for (;;) {
+      void *obj = NULL;
+
+      alloc_lock();
+      if (m->count) {
+        obj = m->objs[--m->count];
+        STAT_MAGAZINE(-1);
+      }
+      alloc_unlock();
+
+      if (obj == NULL)
+        break;
+      magazine_teardown(obj);
+    }
+  }
+}
+#endif
+
+void wilde_magazine_refill(void)
+{
+  for (unsigned i = 0; i < MAGAZINE_HOT; i++)
+    magazine_refill(&magazines[i]);
+}
+
+void wilde_magazine_depth_set(unsigned depth)
+{
+  magazine_depth = MIN(depth, (unsigned)MAGAZINE_MAX_DEPTH);
+}
+
+unsigned wilde_magazine_depth_get(void)
+{
+  return magazine_depth;
+}
+
+/* low priority, only runs when everyone else yields */
+static void magazine_thread(void *arg)
+{
+  UNUSED(arg);
+
+  for (;;) {
+    wilde_magazine_refill();
+    uk_sched_thread_sleep(CONFIG_LIBWILDE_MAGAZINE_INTERVAL * 1000ULL);
+  }
+}
+
+/*
+ * the object of a hot class for a malloc of size bytes, NULL when there is
+ * none ready, its real address goes in RealAddr. Macro so profile sees the
+ * stack of the shim entry point.
+ */
+#define shim_magazine_pop(Size, RealAddr)                                      \
+  ({                                                                           \
+    alloc_lock();                                                              \
+    bool __learned = magazine_note((Size));                                    \
+    void *__obj = magazine_pop((Size));                                        \
+    if (__obj) {                                                               \
+      (RealAddr) = wilde_map_resize(__obj, (Size));                            \
+      profile(__obj, (Size));                                                  \
+    }                                                                          \
+    alloc_unlock();                                                            \
+                                                                               \
+    /* the thread allocates itself, so it's started outside of the lock */     \
+    if (__learned && !magazine_thread_started) {                               \
+      magazine_thread_started = true;                                          \
+      if (!uk_thread_create("wilde-magazines", magazine_thread, NULL))         \
+        uk_pr_warn("No magazine thread, refilling on wilde_magazine_refill() only\n"); \
+    }                                                                          \
+    __obj;                                                                     \
+  })
+#endif
+// }}}
+
 // shim_malloc {{{
 void *shim_malloc(struct uk_alloc *a, size_t size)
 {
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_MALLOC);
   UK_ASSERT(a);
   UK_ASSERT(size);
 
@@ -113,21 +550,53 @@ void *shim_malloc(struct uk_alloc *a, size_t size)
     alloc_printf("malloc(%zu) => NULL\n", size);
     return NULL;
   }
-  alloc_printf("malloc(size=%zu) => %p\n", size, res);
+  trace(WILDE_CALL_MALLOC, size, address, NULL, 0);
+  alloc_printf("malloc(size=%zu) => %p\n", size, address);
   return address;
 
 #else
 
+  /* unprotected allocations go straight to the backing allocator */
+  enum wilde_mode mode = shim_mode(size);
+  if (mode == WILDE_MODE_PASSTHROUGH) {
+    STAT_INC(passthrough);
+    char *address = shimmed->malloc(shimmed, size);
+    trace(WILDE_CALL_MALLOC, size, address, NULL, 0);
+    alloc_printf("malloc(size=%zu) => %p [passthrough]\n", size, address);
+    return address;
+  }
+
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+  /* a hot size, all the mapping work was done in the background */
+  if (mode == WILDE_MODE_ALIAS) {
+    void *real_addr = NULL;
+    void *alias_addr = shim_magazine_pop(size, real_addr);
+    UNUSED(real_addr);
+    if (alias_addr) {
+      trace(WILDE_CALL_MALLOC, size, alias_addr, real_addr, 0);
+      alloc_printf("malloc(size=%zu) => %p [magazine, real=%p]\n", size, alias_addr, real_addr);
+      return alias_addr;
+    }
+  }
+#endif
+
   /* version with wilde */
-  char *real_addr = kmalloc(size);
-  UK_ASSERT(real_addr != 0);
+  LAT_BEGIN(backing);
+  char *real_addr = kretry(kmalloc(size));
+  LAT_END(WILDE_PHASE_BACKING_ALLOC, backing);
+  if (real_addr == NULL) {
+    alloc_printf("malloc(size=%zu) => NULL\n", size);
+    return NULL;
+  }
 
   alloc_lock();
-  char *alias_addr = wilde_map_new(real_addr, size, __PAGE_SIZE);
+  char *alias_addr = shim_map_new(mode, real_addr, size, __PAGE_SIZE);
+  profile(alias_addr, size);
   alloc_unlock();
 
   CLEAR(alias_addr, size);
 
+  trace(WILDE_CALL_MALLOC, size, alias_addr, real_addr, 0);
   alloc_printf("malloc(size=%zu) => %p [real=%p]\n", size, alias_addr, real_addr);
   return alias_addr;
 
@@ -139,6 +608,7 @@ void *shim_malloc(struct uk_alloc *a, size_t size)
 void *shim_calloc(struct uk_alloc *a, size_t nmemb, size_t size)
 {
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_CALLOC);
 
 #ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
 
@@ -149,17 +619,36 @@ void *shim_calloc(struct uk_alloc *a, size_t nmemb, size_t size)
     return NULL;
   }
 
+  trace(WILDE_CALL_CALLOC, nmemb * size, address, NULL, 0);
   alloc_printf("calloc(nmemb=%zu, size=%zu) => %p []\n", nmemb, size, address);
   return address;
 
 #else
 
+  /* unprotected allocations go straight to the backing allocator */
+  enum wilde_mode mode = shim_mode(nmemb * size);
+  if (mode == WILDE_MODE_PASSTHROUGH) {
+    STAT_INC(passthrough);
+    char *address = shimmed->calloc(shimmed, nmemb, size);
+    trace(WILDE_CALL_CALLOC, nmemb * size, address, NULL, 0);
+    alloc_printf("calloc(nmemb=%zu, size=%zu) => %p [passthrough]\n", nmemb, size, address);
+    return address;
+  }
+
   /* version with wilde */
-  char *real_addr = kcalloc(nmemb, size);
+  LAT_BEGIN(backing);
+  char *real_addr = kretry(kcalloc(nmemb, size));
+  LAT_END(WILDE_PHASE_BACKING_ALLOC, backing);
+  if (real_addr == NULL) {
+    alloc_printf("calloc(nmemb=%zu, size=%zu) => NULL\n", nmemb, size);
+    return NULL;
+  }
 
   alloc_lock();
-  char *alias_addr = wilde_map_new(real_addr, nmemb * size, __PAGE_SIZE);
+  char *alias_addr = shim_map_new(mode, real_addr, nmemb * size, __PAGE_SIZE);
+  profile(alias_addr, nmemb * size);
   alloc_unlock();
+  trace(WILDE_CALL_CALLOC, nmemb * size, alias_addr, real_addr, 0);
   alloc_printf("calloc(nmemb=%zu, size=%zu) => %p [real=%p]\n", nmemb, size, alias_addr, real_addr);
 
   return alias_addr;
@@ -168,37 +657,92 @@ void *shim_calloc(struct uk_alloc *a, size_t nmemb, size_t size)
 }
 // }}}
 
-// shim_posix_memalign {{{
-int shim_posix_memalign(struct uk_alloc *a, void **memptr, size_t align, size_t size)
+// shim_aligned {{{
+/*
+ * Common part of posix_memalign and memalign.
+ *
+ * Alignment is done on the alias rather than on the physical memory, the
+ * backing allocation only has to be page aligned for alignments beyond a
+ * page, wilde_map_new then picks a virtual range aligned to align. Smaller
+ * alignments keep their offset in the page, so aligning the physical memory
+ * to align and the alias to a page does the trick.
+ */
+static void *shim_aligned(enum wilde_call call, size_t align, size_t size)
 {
-  UNUSED(a);
-  UK_ASSERT(size);
-  UK_ASSERT(size > align);
+  UNUSED(call);
 
 #ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
 
   /* version without wilde */
-  int res = shimmed->posix_memalign(shimmed, memptr, align, size);
-  if (res != 0) {
-    alloc_printf("posix_memalign(memptr=%p, align=%zu, size=%zu) => %d []\n", memptr, align, size, res);
-    return res;
-  }
+  void *address = shimmed->memalign(shimmed, align, size);
+  if (address)
+    CLEAR(address, size);
 
-  alloc_printf("posix_memalign(memptr=%p, align=%zu, size=%zu) => 0 [memptr=%p]\n", memptr, align, size, real_addr);
+  trace(call, size, address, NULL, align);
+  return address;
 
 #else
 
+  /* unprotected allocations go straight to the backing allocator */
+  enum wilde_mode mode = shim_mode(size);
+  if (mode == WILDE_MODE_PASSTHROUGH) {
+    STAT_INC(passthrough);
+    void *address = shimmed->memalign(shimmed, align, size);
+    if (address)
+      CLEAR(address, size);
+
+    trace(call, size, address, NULL, align);
+    return address;
+  }
+
   /* version with wilde */
-  void *real_addr = kmemalign(align, size);
+  LAT_BEGIN(backing);
+  void *real_addr = kretry(kmemalign(align, size));
+  LAT_END(WILDE_PHASE_BACKING_ALLOC, backing);
+  if (real_addr == NULL)
+    return NULL;
+
   alloc_lock();
-  *memptr = wilde_map_new(real_addr, size, ROUNDUP(align, __PAGE_SIZE));
+  void *alias_addr = shim_map_new(mode, real_addr, size, ROUNDUP(align, __PAGE_SIZE));
+  profile(alias_addr, size);
   alloc_unlock();
 
-  alloc_printf("posix_memalign(memptr=%p, align=%zu, size=%zu) => 0 [memptr=%p, real=%p]\n", memptr, align, size, *memptr, real_addr);
+  UK_ASSERT(((uintptr_t) alias_addr & (align - 1)) == 0);
+  CLEAR(alias_addr, size);
+
+  trace(call, size, alias_addr, real_addr, align);
+  alloc_printf("aligned(align=%zu, size=%zu) => %p [real=%p]\n", align, size, alias_addr, real_addr);
+  return alias_addr;
 
 #endif
+}
+// }}}
+
+// shim_posix_memalign {{{
+int shim_posix_memalign(struct uk_alloc *a, void **memptr, size_t align, size_t size)
+{
+  UNUSED(a);
+  STAT_CALL(WILDE_CALL_POSIX_MEMALIGN);
+  UK_ASSERT(memptr);
+
+  if (!IS_POWER_2(align) || align < sizeof(void *)) {
+    alloc_printf("posix_memalign(memptr=%p, align=%zu, size=%zu) => EINVAL\n", memptr, align, size);
+    return EINVAL;
+  }
+
+  if (size == 0) {
+    *memptr = NULL;
+    return 0;
+  }
+
+  void *address = shim_aligned(WILDE_CALL_POSIX_MEMALIGN, align, size);
+  if (address == NULL) {
+    alloc_printf("posix_memalign(memptr=%p, align=%zu, size=%zu) => ENOMEM\n", memptr, align, size);
+    return ENOMEM;
+  }
 
-  CLEAR(*memptr, size);
+  *memptr = address;
+  alloc_printf("posix_memalign(memptr=%p, align=%zu, size=%zu) => 0 [memptr=%p]\n", memptr, align, size, address);
   return 0;
 }
 // }}}
@@ -207,48 +751,59 @@ int shim_posix_memalign(struct uk_alloc *a, void **memptr, size_t align, size_t
 void *shim_memalign(struct uk_alloc *a, size_t align, size_t size)
 {
   UNUSED(a);
-  UK_CRASH("Does anyone even use this at all?");
+  STAT_CALL(WILDE_CALL_MEMALIGN);
 
-#ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
+  /* memalign is less picky than posix_memalign, small alignments are fine */
+  if (align < sizeof(void *))
+    align = sizeof(void *);
 
-  /* version without wilde */
-  void *address = shimmed->memalign(shimmed, align, size);
-
-  if (address == NULL)
+  if (!IS_POWER_2(align) || size == 0) {
     alloc_printf("memalign(align=%zu, size=%zu) => NULL []\n", align, size);
-  else {
-    alloc_printf("memalign(align=%zu, size=%zu) => %p []\n", align, size, address);
-    CLEAR(address, size);
+    return NULL;
   }
 
+  void *address = shim_aligned(WILDE_CALL_MEMALIGN, align, size);
+  alloc_printf("memalign(align=%zu, size=%zu) => %p\n", align, size, address);
   return address;
+}
+// }}}
 
-#else
+// shim_realloc {{{
+#ifdef CONFIG_LIBWILDE_RELEASE
+void shim_free(struct uk_alloc *a, void *ptr);
 
-  /* version with wilde */
-  void *real_addr = kmemalign(align, size);
+/*
+ * ptr's block is in pieces after wilde_release, so its contents are copied
+ * over through the alias, with released pages reading as 0
+ */
+static void *shim_realloc_released(void *ptr, size_t size)
+{
+  void *new_alias = shim_malloc(&shim, size);
+  if (new_alias == NULL)
+    return NULL;
 
+  /* the new one is contiguous behind its alias, if it got one */
   alloc_lock();
-  void *alias_addr = wilde_map_new(real_addr, size, ROUNDUP(size, __PAGE_SIZE));
+  void *dst = wilde_is_alias(new_alias) ? wilde_map_get(new_alias) : new_alias;
+  wilde_map_copy(dst, ptr, size);
   alloc_unlock();
 
-  alloc_printf("memalign(align=%zu, size=%zu) => %p [real=%p]\n", align, size, alias_addr, real_addr);
-
-  CLEAR(alias_addr, size);
-  return alias_addr;
-#endif
+  shim_free(&shim, ptr);
+  alloc_printf("realloc(ptr=%p, size=%zu) => %p [released]\n", ptr, size, new_alias);
+  return new_alias;
 }
-// }}}
+#endif
 
-// shim_realloc {{{
 void *shim_realloc(struct uk_alloc *a, void *ptr, size_t size)
 {
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_REALLOC);
 
 #ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
 
   /* version without wilde */
   void *address = shimmed->realloc(shimmed, ptr, size);
+  trace(WILDE_CALL_REALLOC, size, address, NULL, (uintptr_t)ptr);
   alloc_printf("realloc(ptr=%p, size=%ld) => %p []\n", ptr, size, address);
   return address;
 
@@ -256,31 +811,83 @@ void *shim_realloc(struct uk_alloc *a, void *ptr, size_t size)
 
   /* edge case */
   if (ptr == NULL) {
-    void *real_addr = kmalloc(size);
+    enum wilde_mode mode = shim_mode(size);
+    if (mode == WILDE_MODE_PASSTHROUGH) {
+      STAT_INC(passthrough);
+      void *address = shimmed->malloc(shimmed, size);
+      trace(WILDE_CALL_REALLOC, size, address, NULL, 0);
+      alloc_printf("realloc(ptr=NULL, size=%ld) => %p [passthrough]\n", size, address);
+      return address;
+    }
+
+    LAT_BEGIN(backing);
+    void *real_addr = kretry(kmalloc(size));
+    LAT_END(WILDE_PHASE_BACKING_ALLOC, backing);
+    if (real_addr == NULL)
+      return NULL;
 
     alloc_lock();
-    void *alias_addr = wilde_map_new(real_addr, size, __PAGE_SIZE);
+    void *alias_addr = shim_map_new(mode, real_addr, size, __PAGE_SIZE);
+    profile(alias_addr, size);
     alloc_unlock();
 
+    trace(WILDE_CALL_REALLOC, size, alias_addr, real_addr, 0);
     alloc_printf("realloc(ptr=NULL, size=%ld) => %p [real=%p]\n", size, alias_addr, real_addr);
     return alias_addr;
   }
 
+#ifdef CONFIG_LIBWILDE_SAMPLER
+  /* unprotected allocations stay with the backing allocator */
+  if (!wilde_is_alias(ptr)) {
+    void *address = shimmed->realloc(shimmed, ptr, size);
+    trace(WILDE_CALL_REALLOC, size, address, NULL, (uintptr_t)ptr);
+    alloc_printf("realloc(ptr=%p, size=%zu) => %p [passthrough]\n", ptr, size, address);
+    return address;
+  }
+#endif
 
-  /* version with wilde */
-  size_t old_size;
 
+  /* version with wilde, ptr stays as it is until the new memory is there */
   alloc_lock();
-  void *old_real = wilde_map_rm(ptr, &old_size);
-  if (old_real == NULL) {
+#ifdef CONFIG_LIBWILDE_RELEASE
+  if (wilde_map_released(ptr)) {
     alloc_unlock();
+    return shim_realloc_released(ptr, size);
+  }
+#endif
+  /* the page tail is the caller's as well, see wilde_usable_size */
+  size_t old_usable = wilde_map_usable(ptr);
+  void *old_real = old_usable ? wilde_map_get(ptr) : NULL;
+  alloc_unlock();
+
+  if (old_real == NULL)
     UK_CRASH("[%s] invalid free at %p\n", __func__, ptr);
+
+  LAT_BEGIN(backing);
+  void *new_real = kretry(kmalloc(size));
+  LAT_END(WILDE_PHASE_BACKING_ALLOC, backing);
+  if (new_real == NULL) {
+    alloc_printf("realloc(ptr=%p, size=%zu) => NULL\n", ptr, size);
+    return NULL;
   }
 
-  void *new_real = krealloc(old_real, old_size, size);
+  memcpy(new_real, old_real, MIN(old_usable, size));
+
+  size_t old_size;
+  alloc_lock();
   void *new_alias = wilde_map_new(new_real, size, __PAGE_SIZE);
+  profile(new_alias, size);
+  old_real = wilde_map_rm(ptr, &old_size);
   alloc_unlock();
 
+  if (old_real == NULL)
+    UK_CRASH("[%s] invalid free at %p\n", __func__, ptr);
+
+  LAT_BEGIN(backing_free);
+  kfree(old_real, old_size);
+  LAT_END(WILDE_PHASE_BACKING_FREE, backing_free);
+
+  trace(WILDE_CALL_REALLOC, size, new_alias, new_real, (uintptr_t)ptr);
   alloc_printf("realloc(ptr=%p, size=%zu) => %p [old_real=%p, new_real=%p]\n", ptr, size, new_alias, old_real, new_real);
 
   return new_alias;
@@ -293,6 +900,7 @@ void *shim_realloc(struct uk_alloc *a, void *ptr, size_t size)
 void shim_free(struct uk_alloc *a, void *ptr)
 {
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_FREE);
 
   if (ptr == NULL) {
     alloc_printf("free(ptr=NULL) => 0\n");
@@ -303,10 +911,21 @@ void shim_free(struct uk_alloc *a, void *ptr)
 
   /* version without wilde */
   shimmed->free(shimmed, ptr);
+  trace(WILDE_CALL_FREE, 0, ptr, NULL, 0);
   alloc_printf("free(ptr=%p) => 0\n", ptr);
 
 #else
 
+#ifdef CONFIG_LIBWILDE_SAMPLER
+  /* anything outside of the alias window was passed through */
+  if (!wilde_is_alias(ptr)) {
+    shimmed->free(shimmed, ptr);
+    trace(WILDE_CALL_FREE, 0, ptr, NULL, 0);
+    alloc_printf("free(ptr=%p) => 0 [passthrough]\n", ptr);
+    return;
+  }
+#endif
+
   /* version with wilde */
   size_t size;
 
@@ -317,29 +936,102 @@ void shim_free(struct uk_alloc *a, void *ptr)
   if (real_addr == NULL)
     UK_CRASH("[%s] invalid free at %p\n", __func__, ptr);
 
-  kfree(real_addr, size);
+  LAT_BEGIN(backing);
+  if (real_addr != WILDE_MAP_FREED)
+    kfree(real_addr, size);
+  LAT_END(WILDE_PHASE_BACKING_FREE, backing);
+  trace(WILDE_CALL_FREE, size, ptr, real_addr, 0);
   alloc_printf("free(ptr=%p) => 0 [real_addr=%p, size=%ld]\n", ptr, real_addr, size);
 
 #endif
 }
 // }}}
 
+// wilde_usable_size & wilde_free_sized {{{
+size_t wilde_usable_size(const void *ptr)
+{
+#ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
+  UNUSED(ptr);
+  return 0;
+#else
+  if (!wilde_is_alias(ptr))
+    return 0;
+
+  alloc_lock();
+  size_t usable = wilde_map_usable((void *)ptr);
+  alloc_unlock();
+
+  return usable;
+#endif
+}
+
+void wilde_free_sized(void *ptr, size_t size)
+{
+  STAT_CALL(WILDE_CALL_FREE);
+
+  if (ptr == NULL) {
+    alloc_printf("free_sized(ptr=NULL, size=%zu) => 0\n", size);
+    return;
+  }
+
+#ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
+
+  /* nothing is aliased, so no size can be checked */
+  UK_CRASH("[%s] invalid free at %p of %zu bytes, not an alias\n", __func__,
+           ptr, size);
+
+#else
+
+  /*
+   * what was passed through has no size wilde knows of, wilde_usable_size
+   * says 0 for it, so any size would go unchecked
+   */
+  if (!wilde_is_alias(ptr))
+    UK_CRASH("[%s] invalid free at %p of %zu bytes, not an alias\n", __func__,
+             ptr, size);
+
+  /* version with wilde, the size is checked before anything is torn down */
+  size_t real_size;
+
+  alloc_lock();
+  void *real_addr = wilde_map_rm_sized(ptr, size, &real_size);
+  alloc_unlock();
+
+  if (real_addr == NULL)
+    UK_CRASH("[%s] invalid free at %p of %zu bytes\n", __func__, ptr, size);
+
+  LAT_BEGIN(backing);
+  if (real_addr != WILDE_MAP_FREED)
+    kfree(real_addr, real_size);
+  LAT_END(WILDE_PHASE_BACKING_FREE, backing);
+  trace(WILDE_CALL_FREE, real_size, ptr, real_addr, 0);
+  alloc_printf("free_sized(ptr=%p, size=%zu) => 0 [real_addr=%p, size=%zu]\n", ptr, size, real_addr, real_size);
+
+#endif
+}
+// }}}
+
 // shim_palloc & shim_free {{{
 #if CONFIG_LIBUKALLOC_IFPAGES
 void *shim_palloc(struct uk_alloc *a, size_t order)
 {
 
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_PALLOC);
 
-  void *address = shimmed->palloc(shimmed, order);
+  LAT_BEGIN(backing);
+  void *address = kretry(shimmed->palloc(shimmed, order));
+  LAT_END(WILDE_PHASE_BACKING_ALLOC, backing);
   if (address == NULL) {
     alloc_printf("palloc(order=%zu) => NULL\n", order);
-    UK_CRASH("Allocating went wrong");
+    return NULL;
   }
+  STAT_ORDER(buddy_orders, order);
 
 #ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
 
   /* version without wilde */
+  trace(WILDE_CALL_PALLOC, __PAGE_SIZE << order, address, NULL, order);
   alloc_printf("palloc(order=%zu) => %p []\n", order, address);
   CLEAR(address, __PAGE_SIZE << order);
   return address;
@@ -348,9 +1040,11 @@ void *shim_palloc(struct uk_alloc *a, size_t order)
 
   /* version with wilde */
   alloc_lock();
-  void *alias_addr = wilde_map_new(address, __PAGE_SIZE << order, __PAGE_SIZE << order);
+  void *alias_addr = wilde_map_new_palloc(address, order);
+  profile(alias_addr, __PAGE_SIZE << order);
   alloc_unlock();
 
+  trace(WILDE_CALL_PALLOC, __PAGE_SIZE << order, alias_addr, address, order);
   alloc_printf("palloc(order=%zu) => %p [real=%p]\n", order, alias_addr, address);
   CLEAR(alias_addr, __PAGE_SIZE << order);
   return alias_addr;
@@ -360,12 +1054,14 @@ void *shim_palloc(struct uk_alloc *a, size_t order)
 void shim_pfree(struct uk_alloc *a, void *ptr, size_t order)
 {
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_PFREE);
 
 #ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
 
   /* version without wilde */
   CLEAR(ptr, __PAGE_SIZE << order);
   shimmed->pfree(shimmed, ptr, order);
+  trace(WILDE_CALL_PFREE, __PAGE_SIZE << order, ptr, NULL, order);
   alloc_printf("pfree(ptr=%p, order=%zu) => 0\n", ptr, order);
 
 #else
@@ -378,7 +1074,10 @@ void shim_pfree(struct uk_alloc *a, void *ptr, size_t order)
   void *real_addr = wilde_map_rm(ptr, NULL);
   alloc_unlock();
 
+  LAT_BEGIN(backing);
   shimmed->pfree(shimmed, real_addr, order);
+  LAT_END(WILDE_PHASE_BACKING_FREE, backing);
+  trace(WILDE_CALL_PFREE, __PAGE_SIZE << order, ptr, real_addr, order);
   alloc_printf("pfree(ptr=%p, order=%zu) => 0 [real=%p]\n", ptr, order, real_addr);
 #endif
 }
@@ -389,6 +1088,7 @@ void shim_pfree(struct uk_alloc *a, void *ptr, size_t order)
 int shim_addmem(struct uk_alloc *a, void *base, size_t size)
 {
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_ADDMEM);
 
   if (!shimmed) {
     dprintf("No backing allocator found, calling uk_alloc_buddy_init(base=%p, "
@@ -417,6 +1117,7 @@ int shim_addmem(struct uk_alloc *a, void *base, size_t size)
 ssize_t shim_availmem(struct uk_alloc *a)
 {
   UNUSED(a);
+  STAT_CALL(WILDE_CALL_AVAILMEM);
 
   ssize_t s = shimmed->availmem(shimmed);
   alloc_printf("availmem() => %zu\n", s);
@@ -425,6 +1126,344 @@ ssize_t shim_availmem(struct uk_alloc *a)
 #endif
 // }}}
 
+// caches {{{
+#ifdef CONFIG_LIBWILDE_CACHE
+/*
+ * Object caches, kmem_cache style. Every cache keeps a magazine of objects
+ * that already have a fresh alias and went through the constructor, so an
+ * allocation is a pop. A free still tears its alias down for good and
+ * prepares a replacement while the magazine has room, the mapping work moves
+ * from alloc to free.
+ */
+#define CACHE_MAGAZINE CONFIG_LIBWILDE_CACHE_MAGAZINE
+
+struct wilde_cache {
+  size_t size;
+  size_t align;
+  void (*ctor)(void *obj);
+  struct uk_list_head list; /* in caches */
+  unsigned count; /* prepared objects in the magazine */
+  void *magazine[CACHE_MAGAZINE];
+};
+
+static UK_LIST_HEAD(caches);
+
+/* a fresh object, mapped in and constructed, NULL when out of memory */
+static void *cache_prepare(struct wilde_cache *cache)
+{
+#ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
+  void *address = shimmed->memalign(shimmed, cache->align, cache->size);
+  if (address == NULL)
+    return NULL;
+#else
+  LAT_BEGIN(backing);
+  void *real_addr = kretry(kmemalign(cache->align, cache->size));
+  LAT_END(WILDE_PHASE_BACKING_ALLOC, backing);
+  if (real_addr == NULL)
+    return NULL;
+
+  alloc_lock();
+  void *address = wilde_map_new(real_addr, cache->size, ROUNDUP(cache->align, __PAGE_SIZE));
+  alloc_unlock();
+#endif
+
+  CLEAR(address, cache->size);
+  if (cache->ctor)
+    cache->ctor(address);
+
+  return address;
+}
+
+/* tears the alias of obj, an object of size bytes, down for good */
+static void cache_teardown(size_t size, void *obj)
+{
+#ifdef CONFIG_LIBWILDE_DISABLE_INJECTION
+  UNUSED(size);
+  shimmed->free(shimmed, obj);
+#else
+  size_t mapped;
+
+  alloc_lock();
+  void *real_addr = wilde_map_rm_sized(obj, size, &mapped);
+  alloc_unlock();
+
+  if (real_addr == NULL)
+    UK_CRASH("[%s] invalid free at %p of %zu bytes\n", __func__, obj, size);
+
+  LAT_BEGIN(backing);
+  if (real_addr != WILDE_MAP_FREED)
+    kfree(real_addr, mapped);
+  LAT_END(WILDE_PHASE_BACKING_FREE, backing);
+#endif
+}
+
+/* puts obj in the magazine, returns false when it's full */
+static bool cache_push(struct wilde_cache *cache, void *obj)
+{
+  alloc_lock();
+  bool room = cache->count < CACHE_MAGAZINE;
+  if (room) {
+    cache->magazine[cache->count++] = obj;
+    STAT_CACHE(1);
+  }
+  alloc_unlock();
+
+  return room;
+}
+
+#ifdef CONFIG_LIBWILDE_PRESSURE
+/* empties the magazines of all caches */
+static void cache_drain(void)
+{
+  for (;;) {
+    struct wilde_cache *iter;
+    void *obj = NULL;
+    size_t size = 0;
+
+    alloc_lock();
+    uk_list_for_each_entry(iter, &caches, list)
+      if (iter->count) {
+        obj = iter->magazine[--iter->count];
+        size = iter->size;
+        STAT_CACHE(-1);
+        break;
+      }
+    alloc_unlock();
+
+    if (obj == NULL)
+      return;
+    cache_teardown(size, obj);
+  }
+}
+#endif
+
+struct wilde_cache *wilde_cache_create(size_t size, size_t align,
+                                       void (*ctor)(void *obj))
+{
+  if (align < sizeof(void *))
+    align = sizeof(void *);
+
+  if (size == 0 || !IS_POWER_2(align))
+    return NULL;
+
+  struct wilde_cache *cache = shimmed->malloc(shimmed, sizeof(*cache));
+  if (cache == NULL)
+    return NULL;
+
+  *cache = (struct wilde_cache){.size = size, .align = align, .ctor = ctor};
+
+  alloc_lock();
+  uk_list_add(&cache->list, &caches);
+  alloc_unlock();
+
+  /* start out full, the first allocations are pops as well */
+  for (unsigned i = 0; i < CACHE_MAGAZINE && !pressure_low; i++) {
+    void *obj = cache_prepare(cache);
+    if (obj == NULL)
+      break;
+    if (!cache_push(cache, obj)) {
+      cache_teardown(cache->size, obj);
+      break;
+    }
+  }
+
+  alloc_printf("cache_create(size=%zu, align=%zu, ctor=%p) => %p\n", size, align, ctor, cache);
+  return cache;
+}
+
+void *wilde_cache_alloc(struct wilde_cache *cache)
+{
+  void *obj = NULL;
+
+  alloc_lock();
+  if (cache->count) {
+    obj = cache->magazine[--cache->count];
+    STAT_CACHE(-1);
+    STAT_INC(cache_hits);
+  }
+  alloc_unlock();
+
+  /* empty, do it the slow way */
+  if (obj == NULL) {
+    STAT_INC(cache_misses);
+    obj = cache_prepare(cache);
+  }
+
+  alloc_printf("cache_alloc(cache=%p) => %p\n", cache, obj);
+  return obj;
+}
+
+void wilde_cache_free(struct wilde_cache *cache, void *obj)
+{
+  if (obj == NULL)
+    return;
+
+  cache_teardown(cache->size, obj);
+  alloc_printf("cache_free(cache=%p, obj=%p) => 0\n", cache, obj);
+
+  /*
+   * the replacement gets an alias of its own, obj's is never handed out
+   * again. The count is only a hint outside the lock, when the magazine
+   * filled up in the meantime cache_push refuses and fresh goes again
+   */
+  if (__atomic_load_n(&cache->count, __ATOMIC_RELAXED) >= CACHE_MAGAZINE ||
+      pressure_low)
+    return;
+
+  void *fresh = cache_prepare(cache);
+  if (fresh && !cache_push(cache, fresh))
+    cache_teardown(cache->size, fresh);
+}
+
+void wilde_cache_destroy(struct wilde_cache *cache)
+{
+  if (cache == NULL)
+    return;
+
+  alloc_lock();
+  uk_list_del(&cache->list);
+  alloc_unlock();
+
+  while (cache->count) {
+    STAT_CACHE(-1);
+    cache_teardown(cache->size, cache->magazine[--cache->count]);
+  }
+
+  shimmed->free(shimmed, cache);
+  alloc_printf("cache_destroy(cache=%p) => 0\n", cache);
+}
+#endif
+// }}}
+
+// arenas {{{
+#ifdef CONFIG_LIBWILDE_ARENA
+struct wilde_arena *wilde_arena_create(size_t size)
+{
+  alloc_lock();
+  struct wilde_arena *arena = arena_create(size);
+  alloc_unlock();
+
+  alloc_printf("arena_create(size=%zu) => %p\n", size, arena);
+  return arena;
+}
+
+void *wilde_arena_alloc(struct wilde_arena *arena, size_t size)
+{
+  return wilde_arena_memalign(arena, ARENA_ALIGN, size);
+}
+
+void *wilde_arena_memalign(struct wilde_arena *arena, size_t align, size_t size)
+{
+  if (!IS_POWER_2(align))
+    return NULL;
+
+  alloc_lock();
+  void *address = arena_alloc(arena, MAX(align, (size_t)ARENA_ALIGN), size);
+  alloc_unlock();
+
+  alloc_printf("arena_memalign(arena=%p, align=%zu, size=%zu) => %p\n", arena, align, size, address);
+  CLEAR(address, address ? size : 0);
+  return address;
+}
+
+void wilde_arena_destroy(struct wilde_arena *arena)
+{
+  if (arena == NULL)
+    return;
+
+  alloc_lock();
+  arena_destroy(arena);
+  alloc_unlock();
+
+  alloc_printf("arena_destroy(arena=%p) => 0\n", arena);
+}
+#endif
+// }}}
+
+// foreign {{{
+#ifdef CONFIG_LIBWILDE_FOREIGN
+void *wilde_map_foreign(const void *buf, size_t len)
+{
+  alloc_lock();
+  void *alias = wilde_map_new_foreign(buf, len);
+  alloc_unlock();
+
+  alloc_printf("map_foreign(buf=%p, len=%zu) => %p\n", buf, len, alias);
+  return alias;
+}
+
+int wilde_unmap_foreign(void *alias)
+{
+  alloc_lock();
+  void *real_addr = wilde_map_rm_foreign(alias);
+  alloc_unlock();
+
+  alloc_printf("unmap_foreign(alias=%p) => %p\n", alias, real_addr);
+  return real_addr ? 0 : -EINVAL;
+}
+#endif
+// }}}
+
+// release {{{
+#ifdef CONFIG_LIBWILDE_RELEASE
+ssize_t wilde_release(void *ptr, size_t off, size_t len)
+{
+  alloc_lock();
+  ssize_t released = wilde_map_release(ptr, off, len);
+  alloc_unlock();
+
+  alloc_printf("release(ptr=%p, off=%zu, len=%zu) => %zd\n", ptr, off, len, released);
+  return released;
+}
+
+ssize_t wilde_commit(void *ptr, size_t off, size_t len)
+{
+  alloc_lock();
+  ssize_t committed = wilde_map_recommit(ptr, off, len);
+  alloc_unlock();
+
+#ifdef CONFIG_LIBWILDE_PRESSURE
+  /* what was mapped in stays, the rest is tried once more */
+  if (committed == -ENOMEM && pressure_relieve()) {
+    alloc_lock();
+    committed = wilde_map_recommit(ptr, off, len);
+    alloc_unlock();
+  }
+#endif
+
+  alloc_printf("commit(ptr=%p, off=%zu, len=%zu) => %zd\n", ptr, off, len, committed);
+  return committed;
+}
+#endif
+// }}}
+
+// reclaim {{{
+#ifdef CONFIG_LIBWILDE_RECLAIM
+size_t wilde_reclaim(uint64_t cycles)
+{
+  alloc_lock();
+  do
+    reclaim_step(cycles ? cycles : UINT64_MAX / 2);
+  while (!cycles && reclaim_queued);
+  size_t queued = reclaim_queued;
+  alloc_unlock();
+
+  return queued;
+}
+#endif
+// }}}
+
+// verify {{{
+bool wilde_verify(struct wilde_verify *out)
+{
+  alloc_lock();
+  bool ok = wilde_map_verify(out);
+  alloc_unlock();
+
+  return ok;
+}
+// }}}
+
 // shim_init {{{
 void *shim_init(void)
 {
@@ -0,0 +1,135 @@
+#define COLOR COLOR_BLUE
+
+#include <uk/assert.h>
+#include <wilde.h>
+#include "shootdown.h"
+#include "percpu.h"
+#include "stats.h"
+#include "util.h"
+#include "x86.h"
+
+#ifndef CONFIG_LIBWILDE_SMP
+#error "shootdown.c is only built with CONFIG_LIBWILDE_SMP"
+#endif
+
+#ifndef CONFIG_LIBWILDE_LOCKING
+#error "Shootdown batches are built under the allocator lock, SMP needs LIBWILDE_LOCKING"
+#endif
+
+#define SHOOTDOWN_BATCH CONFIG_LIBWILDE_SHOOTDOWN_BATCH
+
+u64 shootdown_online;
+u64 shootdown_touched;
+
+/* set by the first wilde_smp_touch(), shootdowns go to shootdown_touched */
+static bool shootdown_narrow;
+
+static void (*shootdown_ipi)(uint64_t cpus);
+
+/*
+ * the batch being built, and while it's shot down read by the other CPUs.
+ * count past SHOOTDOWN_BATCH means everything, pending holds the CPUs that
+ * still have to invalidate
+ */
+static struct {
+  uintptr_t pages[SHOOTDOWN_BATCH];
+  size_t count;
+  u64 pending;
+} batch;
+
+static void shootdown_local(void)
+{
+  if (batch.count > SHOOTDOWN_BATCH) {
+    tlbflush();
+    return;
+  }
+
+  for (size_t i = 0; i < batch.count; i++)
+    tlbflush_page(batch.pages[i]);
+}
+
+void shootdown_page(uintptr_t vaddr)
+{
+  tlbflush_page(vaddr);
+  STAT_INC(tlb_flushes);
+
+  if (batch.count < SHOOTDOWN_BATCH)
+    batch.pages[batch.count] = vaddr;
+  if (batch.count <= SHOOTDOWN_BATCH)
+    batch.count++;
+}
+
+void shootdown_all(void)
+{
+  tlbflush();
+  STAT_INC(tlb_flushes);
+
+  batch.count = SHOOTDOWN_BATCH + 1;
+}
+
+void shootdown_stranger(void)
+{
+  if (__atomic_load_n(&shootdown_online, __ATOMIC_ACQUIRE) || shootdown_ipi)
+    UK_CRASH("wilde: a CPU that was never brought online calls in, every core "
+             "has to call wilde_smp_cpu_online()\n");
+}
+
+void shootdown_finish(void)
+{
+  u64 *targets = __atomic_load_n(&shootdown_narrow, __ATOMIC_ACQUIRE)
+                     ? &shootdown_touched
+                     : &shootdown_online;
+  u64 cpus = __atomic_load_n(targets, __ATOMIC_ACQUIRE) & ~POW2(wilde_cpu_id());
+
+  if (batch.count == 0)
+    return;
+
+  if (cpus) {
+    if (!shootdown_ipi)
+      UK_CRASH("wilde: CPUs %#lx hold aliases, but there's no IPI hook\n", cpus);
+
+    /* the batch is complete before anyone sees it pending */
+    __atomic_store_n(&batch.pending, cpus, __ATOMIC_RELEASE);
+    shootdown_ipi(cpus);
+
+    while (__atomic_load_n(&batch.pending, __ATOMIC_ACQUIRE))
+      __builtin_ia32_pause();
+
+    STAT_INC(tlb_shootdowns);
+    STAT_ADD(tlb_ipis, __builtin_popcountll(cpus));
+  }
+
+  batch.count = 0;
+}
+
+// public interface {{{
+void wilde_smp_cpu_online(unsigned cpu)
+{
+  UK_ASSERT(cpu < WILDE_NR_CPUS);
+  wilde_cpu_set_id(cpu);
+  __atomic_fetch_or(&shootdown_online, POW2(cpu), __ATOMIC_SEQ_CST);
+}
+
+void wilde_smp_ipi_set(void (*send)(uint64_t cpus))
+{
+  shootdown_ipi = send;
+}
+
+void wilde_smp_touch(void)
+{
+  shootdown_touch();
+  __atomic_store_n(&shootdown_narrow, true, __ATOMIC_RELEASE);
+}
+
+void wilde_smp_shootdown(void)
+{
+  u64 self = POW2(wilde_cpu_id());
+
+  /* a spurious or late interrupt, nothing asked of this CPU */
+  if ((__atomic_load_n(&batch.pending, __ATOMIC_ACQUIRE) & self) == 0)
+    return;
+
+  shootdown_local();
+  __atomic_fetch_and(&batch.pending, ~self, __ATOMIC_RELEASE);
+}
+// }}}
@@ -0,0 +1,76 @@
+#ifndef __WILDE_SHOOTDOWN_H__
+#define __WILDE_SHOOTDOWN_H__
+#include "util.h"
+#include "percpu.h"
+#include "stats.h"
+#include "x86.h"
+
+/*
+ * TLB invalidation of unmapped aliases.
+ *
+ * Unmapping invalidates the local TLB right away, page by page with
+ * shootdown_page() or all of it with shootdown_all(). shootdown_finish() then
+ * makes sure no other CPU holds on to the translations either, it has to run
+ * before the memory behind them is handed out again.
+ *
+ * On a single core that's all there is to it. Under CONFIG_LIBWILDE_SMP the
+ * pages are collected in a batch, and shootdown_finish() interrupts every
+ * other online CPU once for the whole batch and waits until they invalidated
+ * it. Any of them may have dereferenced an alias another CPU handed it. Only
+ * once the application called wilde_smp_touch() does it narrow down to the
+ * CPUs that called into wilde or wilde_smp_touch(). Batches are built under
+ * the allocator lock.
+ */
+#ifdef CONFIG_LIBWILDE_SMP
+
+/* a bit per wilde_cpu_id(), of CPUs brought online and of CPUs that called in */
+extern u64 shootdown_online;
+extern u64 shootdown_touched;
+
+void shootdown_page(uintptr_t vaddr);
+void shootdown_all(void);
+void shootdown_finish(void);
+void shootdown_stranger(void);
+
+/* marks the calling CPU as one to interrupt when narrowed, cheap once it is */
+static inline void shootdown_touch(void)
+{
+  u64 self = POW2(wilde_cpu_id());
+
+  if ((__atomic_load_n(&shootdown_touched, __ATOMIC_RELAXED) & self) == 0)
+    __atomic_fetch_or(&shootdown_touched, self, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * the calling CPU is about to use aliases. One without an id would share
+ * CPU 0's per CPU state and never be interrupted, that's only fine when it's
+ * the only one
+ */
+static inline void shootdown_enter(void)
+{
+  if (!wilde_cpu_tag())
+    shootdown_stranger();
+  shootdown_touch();
+}
+
+#else
+
+static inline void shootdown_page(uintptr_t vaddr)
+{
+  tlbflush_page(vaddr);
+  STAT_INC(tlb_flushes);
+}
+
+static inline void shootdown_all(void)
+{
+  tlbflush();
+  STAT_INC(tlb_flushes);
+}
+
+static inline void shootdown_finish(void) {}
+static inline void shootdown_touch(void) {}
+static inline void shootdown_enter(void) {}
+
+#endif /* CONFIG_LIBWILDE_SMP */
+
+#endif /* __WILDE_SHOOTDOWN_H__ */
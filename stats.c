@@ -0,0 +1,169 @@
+#define COLOR COLOR_WHITE
+
+#include <string.h>
+#include <uk/list.h>
+#include "stats.h"
+#include "alias.h"
+#include "vbuddy.h"
+#include "wilde_internal.h"
+#include "util.h"
+#ifdef CONFIG_LIBWILDE_KELLOGS
+#include "kallocs_malloc.h"
+#endif
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+#include "magazine.h"
+#endif
+#ifdef CONFIG_LIBWILDE_RECLAIM
+#include "reclaim.h"
+#endif
+
+struct stats_pcpu stats_pcpu[WILDE_NR_CPUS];
+struct stats_live stats_live;
+
+size_t stats_physical(uintptr_t alias, size_t size)
+{
+  /* palloc hands out whole blocks */
+  if (alias >= VMAP_PALLOC_START)
+    return size;
+
+#ifdef CONFIG_LIBWILDE_KELLOGS
+  return kallocs_block_size(size);
+#else
+  /* uk_malloc_ifpages, 16 bytes of metadata, rounded up to a buddy block */
+  size_t pages = ROUNDUP(size + 16, __PAGE_SIZE) / __PAGE_SIZE;
+  return __PAGE_SIZE << (pages > 1 ? LOG2(pages - 1) + 1 : 0);
+#endif
+}
+
+void wilde_stats_get(struct wilde_stats *out)
+{
+  memset(out, 0, sizeof(*out));
+
+  for (int cpu = 0; cpu < WILDE_NR_CPUS; cpu++) {
+    const struct stats_pcpu *s = &stats_pcpu[cpu];
+
+    for (int i = 0; i < WILDE_CALLS; i++)
+      out->calls[i] += s->calls[i];
+
+    out->passthrough += s->passthrough;
+    out->ptes_set += s->ptes_set;
+    out->ptes_cleared += s->ptes_cleared;
+    out->pt_pages_alloc += s->pt_pages_alloc;
+    out->pt_pages_freed += s->pt_pages_freed;
+    out->tlb_flushes += s->tlb_flushes;
+    out->tlb_shootdowns += s->tlb_shootdowns;
+    out->tlb_ipis += s->tlb_ipis;
+    out->magazine_hits += s->magazine_hits;
+    out->magazine_misses += s->magazine_misses;
+    out->cache_hits += s->cache_hits;
+    out->cache_misses += s->cache_misses;
+    out->alias_lookups += s->alias_lookups;
+
+    for (int i = 0; i < WILDE_STATS_PROBES; i++)
+      out->alias_probes[i] += s->alias_probes[i];
+
+    for (int i = 0; i < WILDE_STATS_ORDERS; i++) {
+      out->buddy_orders[i] += s->buddy_orders[i];
+      out->va_orders[i] += s->va_orders[i];
+    }
+  }
+
+  out->live_bytes = stats_live.bytes;
+  out->live_objects = stats_live.objects;
+  out->peak_bytes = stats_live.peak_bytes;
+  out->peak_objects = stats_live.peak_objects;
+  out->alias_entries = stats_live.aliases;
+  out->pt_pages = stats_live.pt_pages;
+  out->metadata_pages = stats_live.metadata_pages;
+  out->magazine_objects = stats_live.magazine_objects;
+  out->cache_objects = stats_live.cache_objects;
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+  out->magazine_depth = magazine_depth;
+#endif
+#ifdef CONFIG_LIBWILDE_RECLAIM
+  out->reclaim_queued = reclaim_queued;
+#endif
+
+  for (int i = 0; i < WILDE_STATS_CLASSES; i++) {
+    const struct stats_class *c = &stats_live.classes[i];
+    out->classes[i] = (struct wilde_stats_class){
+      .objects = c->objects,
+      .requested = c->requested,
+      .physical = c->physical,
+    };
+    out->requested_bytes += c->requested;
+    out->physical_bytes += c->physical;
+  }
+  out->alias_buckets = LOOKUP_SIZE;
+
+  out->va_remaining = vmem_remaining();
+  out->va_used = (VMAP_SIZE - VMAP_PALLOC_SIZE) - out->va_remaining;
+  out->palloc_va_remaining = vbuddy_remaining();
+  out->palloc_va_used = VMAP_PALLOC_SIZE - out->palloc_va_remaining;
+}
+
+void wilde_stats_reset(void)
+{
+  memset(stats_pcpu, 0, sizeof(stats_pcpu));
+  stats_live.peak_bytes = stats_live.bytes;
+  stats_live.peak_objects = stats_live.objects;
+}
+
+static void stats_dump_orders(const char *name, const uint64_t *orders)
+{
+  hprintf("  %-16s", name);
+  for (int i = 0; i < WILDE_STATS_ORDERS; i++)
+    if (orders[i])
+      hprintf(" %d:%lu", i, orders[i]);
+  hprintf("\n");
+}
+
+void wilde_stats_dump(void)
+{
+  static const char *const names[WILDE_CALLS] = {
+    "malloc", "calloc", "realloc", "posix_memalign", "memalign",
+    "free", "palloc", "pfree", "addmem", "availmem",
+  };
+  struct wilde_stats s;
+
+  wilde_stats_get(&s);
+  lprintf("wilde statistics\n");
+
+  for (int i = 0; i < WILDE_CALLS; i++)
+    hprintf("  %-16s %lu\n", names[i], s.calls[i]);
+  hprintf("  %-16s %lu\n", "passthrough", s.passthrough);
+
+  hprintf("  live             %lu bytes in %lu objects (peak %lu bytes, %lu objects)\n",
+          s.live_bytes, s.live_objects, s.peak_bytes, s.peak_objects);
+  hprintf("  ptes             %lu set, %lu cleared\n", s.ptes_set, s.ptes_cleared);
+  hprintf("  pt pages         %lu allocated, %lu freed\n", s.pt_pages_alloc, s.pt_pages_freed);
+  hprintf("  tlb flushes      %lu, %lu shootdowns, %lu ipis\n", s.tlb_flushes,
+          s.tlb_shootdowns, s.tlb_ipis);
+  hprintf("  reclaim          %lu tables queued\n", s.reclaim_queued);
+  hprintf("  magazines        %lu prepared, %lu hits, %lu misses, depth %lu\n",
+          s.magazine_objects, s.magazine_hits, s.magazine_misses,
+          s.magazine_depth);
+  hprintf("  caches           %lu prepared, %lu hits, %lu misses\n",
+          s.cache_objects, s.cache_hits, s.cache_misses);
+  hprintf("  alias table      %lu entries in %lu buckets, %lu lookups, probes",
+          s.alias_entries, s.alias_buckets, s.alias_lookups);
+  for (int i = 0; i < WILDE_STATS_PROBES; i++)
+    hprintf(" <%d:%lu", (1 << (i + 1)) - 1, s.alias_probes[i]);
+  hprintf("\n");
+  hprintf("  malloc window    %lu used, %lu remaining\n", s.va_used, s.va_remaining);
+  hprintf("  palloc window    %lu used, %lu remaining\n", s.palloc_va_used, s.palloc_va_remaining);
+  stats_dump_orders("buddy orders", s.buddy_orders);
+  stats_dump_orders("va orders", s.va_orders);
+
+  hprintf("  memory           %lu requested, %lu physical, %lu waste\n",
+          s.requested_bytes, s.physical_bytes, s.physical_bytes - s.requested_bytes);
+  hprintf("  overhead         %lu page table pages, %lu metadata pages\n",
+          s.pt_pages, s.metadata_pages);
+  for (int i = 0; i < WILDE_STATS_CLASSES; i++) {
+    const struct wilde_stats_class *c = &s.classes[i];
+    if (c->objects == 0)
+      continue;
+    hprintf("    [2^%-2d] %8lu objects, %12lu requested, %12lu physical, %12lu waste\n",
+            i, c->objects, c->requested, c->physical, c->physical - c->requested);
+  }
+}
@@ -0,0 +1,130 @@
+#ifndef __WILDE_STATS_H__
+#define __WILDE_STATS_H__
+#include <stdint.h>
+#include <wilde.h>
+#include "percpu.h"
+#include "util.h"
+
+/*
+ * Allocator statistics, cheap enough to leave on.
+ *
+ * Counters that only ever add up are kept per CPU, without atomics. Live and
+ * peak figures are only touched while mapping, which happens under the
+ * allocator lock, so those are kept once.
+ */
+
+#ifdef CONFIG_LIBWILDE_STATS
+
+struct stats_pcpu {
+  u64 calls[WILDE_CALLS];
+  u64 passthrough;
+  u64 ptes_set;
+  u64 ptes_cleared;
+  u64 pt_pages_alloc;
+  u64 pt_pages_freed;
+  u64 tlb_flushes;
+  u64 tlb_shootdowns;
+  u64 tlb_ipis;
+  u64 magazine_hits;
+  u64 magazine_misses;
+  u64 cache_hits;
+  u64 cache_misses;
+  u64 alias_lookups;
+  u64 alias_probes[WILDE_STATS_PROBES];
+  u64 buddy_orders[WILDE_STATS_ORDERS];
+  u64 va_orders[WILDE_STATS_ORDERS];
+};
+
+struct stats_class {
+  u64 objects;
+  u64 requested;
+  u64 physical;
+};
+
+struct stats_live {
+  u64 bytes;
+  u64 objects;
+  u64 peak_bytes;
+  u64 peak_objects;
+  u64 aliases;
+  u64 pt_pages;
+  u64 metadata_pages;
+  u64 magazine_objects;
+  u64 cache_objects;
+  struct stats_class classes[WILDE_STATS_CLASSES];
+};
+
+extern struct stats_pcpu stats_pcpu[WILDE_NR_CPUS];
+extern struct stats_live stats_live;
+
+#define STAT_ADD(Field, N) (PERCPU(stats_pcpu).Field += (N))
+#define STAT_INC(Field) STAT_ADD(Field, 1)
+#define STAT_CALL(Call) STAT_INC(calls[(Call)])
+#define STAT_ORDER(Field, Order)                                               \
+  STAT_INC(Field[MIN((size_t)(Order), (size_t)WILDE_STATS_ORDERS - 1)])
+#define STAT_PROBE(N)                                                          \
+  STAT_INC(alias_probes[MIN(LOG2((N) + 1), WILDE_STATS_PROBES - 1)])
+
+/* bytes the backing allocator holds for an object of size bytes at alias */
+size_t stats_physical(uintptr_t alias, size_t size);
+
+static inline struct stats_class *stats_class(size_t size)
+{
+  return &stats_live.classes[MIN((size_t)LOG2(size), WILDE_STATS_CLASSES - 1)];
+}
+
+static inline void stats_live_add(uintptr_t alias, size_t bytes)
+{
+  struct stats_class *c = stats_class(bytes);
+
+  c->objects++;
+  c->requested += bytes;
+  c->physical += stats_physical(alias, bytes);
+
+  stats_live.bytes += bytes;
+  stats_live.objects++;
+
+  if (stats_live.bytes > stats_live.peak_bytes)
+    stats_live.peak_bytes = stats_live.bytes;
+  if (stats_live.objects > stats_live.peak_objects)
+    stats_live.peak_objects = stats_live.objects;
+}
+
+static inline void stats_live_sub(uintptr_t alias, size_t bytes)
+{
+  struct stats_class *c = stats_class(bytes);
+
+  c->objects--;
+  c->requested -= bytes;
+  c->physical -= stats_physical(alias, bytes);
+
+  stats_live.bytes -= bytes;
+  stats_live.objects--;
+}
+
+#define STAT_LIVE_ADD(Alias, Bytes) stats_live_add((Alias), (Bytes))
+#define STAT_LIVE_SUB(Alias, Bytes) stats_live_sub((Alias), (Bytes))
+#define STAT_ALIAS(N) (stats_live.aliases += (N))
+#define STAT_PT_PAGES(N) (stats_live.pt_pages += (N))
+#define STAT_METADATA_PAGES(N) (stats_live.metadata_pages += (N))
+#define STAT_MAGAZINE(N) (stats_live.magazine_objects += (N))
+#define STAT_CACHE(N) (stats_live.cache_objects += (N))
+
+#else
+
+#define STAT_ADD(Field, N) do {} while (0)
+#define STAT_INC(Field) do {} while (0)
+#define STAT_CALL(Call) do {} while (0)
+#define STAT_ORDER(Field, Order) do {} while (0)
+#define STAT_PROBE(N) do {} while (0)
+#define STAT_LIVE_ADD(Alias, Bytes) do {} while (0)
+#define STAT_LIVE_SUB(Alias, Bytes) do {} while (0)
+#define STAT_ALIAS(N) do {} while (0)
+#define STAT_PT_PAGES(N) do {} while (0)
+#define STAT_METADATA_PAGES(N) do {} while (0)
+#define STAT_MAGAZINE(N) do {} while (0)
+#define STAT_CACHE(N) do {} while (0)
+
+#endif /* CONFIG_LIBWILDE_STATS */
+
+#endif /* __WILDE_STATS_H__ */
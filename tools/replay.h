@@ -0,0 +1,198 @@
+#ifndef __WILDE_REPLAY_H__
+#define __WILDE_REPLAY_H__
+
+/*
+ * Replay engine, drives a uk_alloc with a trace converted by
+ * tools/wilde-trace -r and measures it in phases of a fixed number of calls.
+ *
+ * Header only, it's built into tools/wilde-replay against the host build as
+ * well as into apps/wilde-bench against the real thing. The replayed objects
+ * are never touched, on the host their aliases aren't even mapped.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <uk/alloc.h>
+#include <wilde_trace.h>
+
+/* log linear latency histogram, 16 buckets per power of 2 */
+#define REPLAY_HIST_SUB 16
+#define REPLAY_HIST (64 * REPLAY_HIST_SUB)
+
+struct replay_phase {
+  uint64_t first;      /* index of the first record of the phase */
+  uint64_t ops;        /* calls made */
+  uint64_t skipped;    /* records naming objects from before the trace */
+  uint64_t cycles;     /* spent in the allocator */
+  uint64_t max_cycles;
+  uint64_t live_bytes; /* requested bytes alive at the end of the phase */
+  uint64_t peak_bytes;
+  uint64_t hist[REPLAY_HIST];
+};
+
+typedef void (*replay_report_t)(const struct replay_phase *phase, void *arg);
+
+static inline uint64_t replay_rdtsc(void)
+{
+  uint32_t low, high;
+  __asm__ __volatile__("rdtsc" : "=a"(low), "=d"(high));
+  return ((uint64_t)high << 32) | low;
+}
+
+static inline unsigned replay_hist_index(uint64_t cycles)
+{
+  if (cycles < REPLAY_HIST_SUB)
+    return cycles;
+
+  unsigned n = 63 - __builtin_clzll(cycles);
+  return (n - 3) * REPLAY_HIST_SUB + ((cycles >> (n - 4)) & (REPLAY_HIST_SUB - 1));
+}
+
+/* lower bound of the bucket holding the permille'th percentile */
+static inline uint64_t replay_percentile(const struct replay_phase *p,
+                                         unsigned permille)
+{
+  uint64_t target = (p->ops * permille + 999) / 1000, seen = 0;
+
+  for (unsigned i = 0; i < REPLAY_HIST; i++) {
+    seen += p->hist[i];
+    if (seen && seen >= target) {
+      if (i < REPLAY_HIST_SUB)
+        return i;
+
+      unsigned n = i / REPLAY_HIST_SUB + 3;
+      return (uint64_t)(REPLAY_HIST_SUB + i % REPLAY_HIST_SUB) << (n - 4);
+    }
+  }
+
+  return 0;
+}
+
+/* validates a replay buffer, returns the number of object slots it needs */
+static inline size_t replay_objects(const void *buf, size_t len)
+{
+  const struct wilde_replay_header *h = buf;
+
+  if (len < sizeof(*h) || h->magic != WILDE_REPLAY_MAGIC ||
+      h->version != WILDE_REPLAY_VERSION ||
+      (len - sizeof(*h)) / sizeof(struct wilde_replay_record) < h->nr)
+    return 0;
+
+  return (size_t)h->objects + 1;
+}
+
+/*
+ * Replays buf on a, objs and sizes are replay_objects() zeroed slots kept by
+ * the caller. Every phase_ops records report is called, and once more for
+ * the tail. With pace the original gaps between calls are kept.
+ *
+ * returns the number of records replayed, -1 on a malformed buffer
+ */
+static inline int64_t replay_run(struct uk_alloc *a, const void *buf,
+                                 size_t len, void **objs, size_t *sizes,
+                                 uint64_t phase_ops, bool pace,
+                                 replay_report_t report, void *arg)
+{
+  const struct wilde_replay_header *h = buf;
+  const struct wilde_replay_record *recs = (const void *)(h + 1);
+  size_t nr_objs = replay_objects(buf, len);
+  struct replay_phase phase;
+  uint64_t live = 0, peak = 0, last = replay_rdtsc();
+
+  if (!nr_objs)
+    return -1;
+
+  memset(&phase, 0, sizeof(phase));
+
+  for (uint64_t i = 0; i < h->nr; i++) {
+    const struct wilde_replay_record *r = &recs[i];
+    size_t align = (size_t)1 << r->order;
+    void *p = NULL, *old = NULL;
+
+    if (r->id >= nr_objs || r->old_id >= nr_objs)
+      return -1;
+
+    if (pace)
+      while (replay_rdtsc() - last < r->dtsc)
+        ;
+
+    /* frees of objects we never saw, and allocations that failed */
+    bool is_free = r->op == WILDE_CALL_FREE || r->op == WILDE_CALL_PFREE;
+    if (!r->id || (is_free && !objs[r->id])) {
+      phase.skipped++;
+      goto next;
+    }
+
+    if (r->op == WILDE_CALL_REALLOC && r->old_id) {
+      old = objs[r->old_id];
+      live -= sizes[r->old_id];
+      objs[r->old_id] = NULL;
+    }
+
+    uint64_t t = replay_rdtsc();
+    switch (r->op) {
+    case WILDE_CALL_MALLOC:
+      p = uk_malloc(a, r->size);
+      break;
+    case WILDE_CALL_CALLOC:
+      p = uk_calloc(a, 1, r->size);
+      break;
+    case WILDE_CALL_REALLOC:
+      p = uk_realloc(a, old, r->size);
+      break;
+    case WILDE_CALL_POSIX_MEMALIGN:
+      if (uk_posix_memalign(a, &p, align, r->size))
+        p = NULL;
+      break;
+    case WILDE_CALL_MEMALIGN:
+      p = uk_memalign(a, align, r->size);
+      break;
+    case WILDE_CALL_PALLOC:
+      p = uk_palloc(a, r->order);
+      break;
+    case WILDE_CALL_FREE:
+      uk_free(a, objs[r->id]);
+      break;
+    case WILDE_CALL_PFREE:
+      uk_pfree(a, objs[r->id], r->order);
+      break;
+    default:
+      return -1;
+    }
+    last = replay_rdtsc();
+
+    uint64_t cycles = last - t;
+    phase.ops++;
+    phase.cycles += cycles;
+    phase.hist[replay_hist_index(cycles)]++;
+    if (cycles > phase.max_cycles)
+      phase.max_cycles = cycles;
+
+    if (is_free) {
+      live -= sizes[r->id];
+      objs[r->id] = NULL;
+    } else {
+      objs[r->id] = p;
+      sizes[r->id] = r->op == WILDE_CALL_PALLOC ? 4096UL << r->order : r->size;
+      live += sizes[r->id];
+      if (live > peak)
+        peak = live;
+    }
+
+  next:
+    if (phase.ops + phase.skipped == phase_ops || i + 1 == h->nr) {
+      phase.live_bytes = live;
+      phase.peak_bytes = peak;
+      report(&phase, arg);
+
+      memset(&phase, 0, sizeof(phase));
+      phase.first = i + 1;
+      peak = live;
+    }
+  }
+
+  return h->nr;
+}
+
+#endif /* __WILDE_REPLAY_H__ */
@@ -0,0 +1,113 @@
+/*
+ * Replays a trace against the host build of wilde
+ *
+ * Takes a replay file from tools/wilde-trace -r and drives the shim of the
+ * host build (host/) with exactly those calls, printing latency and memory
+ * per phase of -w calls as CSV. Build the host library with the options to
+ * compare, e.g.
+ *
+ *   make tools HOST_CONFIG="LIBWILDE_KELLOGS LIBWILDE_STATS"
+ *   tools/wilde-replay [-m pool MB] [-w calls per phase] [-p] trace.replay
+ *
+ * -p keeps the original gaps between calls.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <wilde_host.h>
+#include "replay.h"
+
+static void report(const struct replay_phase *p, void *arg)
+{
+  struct uk_alloc *a = arg;
+
+  printf("%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%ld\n", p->first, p->ops,
+         p->skipped, p->ops ? p->cycles / p->ops : 0,
+         replay_percentile(p, 500), replay_percentile(p, 990),
+         p->max_cycles, p->live_bytes, p->peak_bytes,
+         (long)a->availmem(a));
+}
+
+int main(int argc, char **argv)
+{
+  size_t pool_mb = 4096;
+  uint64_t phase_ops = 100000;
+  bool pace = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "m:w:p")) != -1) {
+    switch (opt) {
+    case 'm':
+      pool_mb = strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      phase_ops = strtoull(optarg, NULL, 0);
+      break;
+    case 'p':
+      pace = true;
+      break;
+    default:
+      goto usage;
+    }
+  }
+
+  if (optind + 1 != argc || !phase_ops)
+    goto usage;
+
+  FILE *f = fopen(argv[optind], "rb");
+  if (!f) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  fseek(f, 0, SEEK_END);
+  size_t len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  void *buf = malloc(len);
+  if (!buf || fread(buf, 1, len, f) != len) {
+    perror(argv[optind]);
+    return 1;
+  }
+  fclose(f);
+
+  size_t nr_objs = replay_objects(buf, len);
+  if (!nr_objs) {
+    fprintf(stderr, "wilde-replay: %s is not a replay file\n", argv[optind]);
+    return 1;
+  }
+
+  void **objs = calloc(nr_objs, sizeof(*objs));
+  size_t *sizes = calloc(nr_objs, sizeof(*sizes));
+  if (!objs || !sizes) {
+    perror("calloc");
+    return 1;
+  }
+
+  struct uk_alloc *a = wilde_host_init(pool_mb << 20);
+  if (!a) {
+    fprintf(stderr, "wilde-replay: couldn't set up a %zuMB pool\n", pool_mb);
+    return 1;
+  }
+
+  printf("first,ops,skipped,mean_cycles,p50_cycles,p99_cycles,max_cycles,"
+         "live_bytes,peak_bytes,pool_free\n");
+
+  if (replay_run(a, buf, len, objs, sizes, phase_ops, pace, report, a) < 0) {
+    fprintf(stderr, "wilde-replay: malformed replay file\n");
+    return 1;
+  }
+
+  struct wilde_host_counters c;
+  wilde_host_counters(&c);
+  fprintf(stderr, "wilde-replay: %lu invlpg, %lu cr3 writes\n", c.invlpgs,
+          c.cr3_writes);
+
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-m pool MB] [-w calls per phase] [-p] "
+          "trace.replay\n", argv[0]);
+  return 1;
+}
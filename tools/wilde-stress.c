@@ -0,0 +1,595 @@
+/*
+ * Scaling stress test of the mapping engine, on the host build of wilde
+ *
+ * Drives wilde from a seed through the regimes it hits in production, one
+ * after the other:
+ *
+ *   scale     grows to -n live small objects, then frees them in random order
+ *   fragment  churns -n / 16 objects with alignments up to 1MB, every aligned
+ *             reservation leaves a head behind in vmem_free
+ *   span      churns a few 1MB to 64MB objects, crossing p4, p3 and p2 table
+ *             boundaries, until the malloc window is nearly exhausted
+ *   hot       churns -n / 16 objects, 7 in 8 of a few hot sizes, refilling the
+ *             magazines every HOT_REFILL calls as their thread would (needs
+ *             LIBWILDE_MAGAZINES), magazine hits and misses go to stderr
+ *   cache     churns CACHE_SLOTS objects of a wilde_cache, popped out of and
+ *             refilled into its magazine (needs LIBWILDE_CACHE)
+ *   arena     fills arenas with ARENA_OBJECTS small objects and destroys them
+ *             whole, -n objects in total (needs LIBWILDE_ARENA)
+ *   smp       churns -n / 16 small objects from 1, 2, 4, ... simulated CPUs
+ *             up to LIBWILDE_NR_CPUS, -n calls each, the shootdown IPIs are
+ *             delivered in turn, shootdowns and IPIs per free and the
+ *             throughput of the churn's frees go to stderr
+ *             (needs LIBWILDE_SMP LIBWILDE_LOCKING)
+ *
+ * Every -w calls a CSV row goes to stdout, so throughput and page table
+ * memory can be plotted against the live objects or the window used. Every
+ * -v rows, and at the end of every regime, wilde_verify() checks the alias
+ * table against the page tables, a failure stops the run.
+ *
+ *   make tools HOST_CONFIG="LIBWILDE_KELLOGS LIBWILDE_STATS LIBWILDE_SHAUN"
+ *   tools/wilde-stress [-s seed] [-n objects] [-w calls per row]
+ *                      [-v rows per verify] [-m pool MB] [regime...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <wilde_host.h>
+#include <wilde.h>
+
+#ifndef CONFIG_LIBWILDE_STATS
+#error "wilde-stress needs LIBWILDE_STATS in HOST_CONFIG"
+#endif
+
+#define SPAN_LIVE 8
+#define SPAN_MIN (1UL << 20)
+#define SPAN_MAX (64UL << 20)
+
+/* every ASLR region can strand a tail too short for the next object */
+#define SPAN_RESERVE (256 * SPAN_MAX)
+
+#define HOT_REFILL 64
+
+#define CACHE_SLOTS 1024
+#define CACHE_OBJECT 64
+
+#define ARENA_OBJECTS 4096
+#define ARENA_SIZE (ARENA_OBJECTS * 256UL)
+
+#define SMP_STAGES 8
+
+static struct uk_alloc *a;
+static uint64_t rng;
+static uint64_t row_ops = 65536;
+static uint64_t verify_rows;
+
+// helpers {{{
+static inline uint64_t rnd(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static inline uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void verify(const char *regime, uint64_t ops)
+{
+  struct wilde_verify v;
+
+  if (wilde_verify(&v))
+    return;
+
+  fprintf(stderr,
+          "wilde-stress: %s inconsistent after %lu calls: %lu aliases, "
+          "%lu pages, %lu mapped, %lu free vmas, bad: %lu aliases, %lu pages, "
+          "%lu guards, %lu vmas\n",
+          regime, ops, v.aliases, v.pages, v.mapped, v.free_vmas,
+          v.bad_aliases, v.bad_pages, v.bad_guards, v.bad_vmas);
+  exit(1);
+}
+// }}}
+
+// rows {{{
+struct run {
+  const char *regime;
+  uint64_t ops;
+  uint64_t rows;
+  uint64_t live_objects;
+  uint64_t live_bytes;
+  uint64_t row_start; /* ns */
+  uint64_t row_first; /* ops at row_start */
+};
+
+static void run_begin(struct run *r, const char *regime)
+{
+  memset(r, 0, sizeof(*r));
+  r->regime = regime;
+  r->row_start = now_ns();
+}
+
+static void run_row(struct run *r)
+{
+  struct wilde_stats s;
+  struct wilde_host_counters c;
+  uint64_t ns = now_ns() - r->row_start;
+
+  wilde_stats_get(&s);
+  wilde_host_counters(&c);
+
+  printf("%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", r->regime, r->ops,
+         r->live_objects, r->live_bytes,
+         ns ? (r->ops - r->row_first) * 1000000 / ns : 0, s.va_used,
+         s.pt_pages, c.invlpgs);
+
+  if (verify_rows && ++r->rows % verify_rows == 0)
+    verify(r->regime, r->ops);
+
+  r->row_first = r->ops;
+  r->row_start = now_ns();
+}
+
+/* counts one call, printing a row every row_ops of them */
+static void run_op(struct run *r)
+{
+  if (++r->ops % row_ops == 0)
+    run_row(r);
+}
+
+static void run_end(struct run *r)
+{
+  if (r->ops != r->row_first)
+    run_row(r);
+  verify(r->regime, r->ops);
+}
+
+static void *run_alloc(struct run *r, size_t align, size_t size)
+{
+  void *p = align ? uk_memalign(a, align, size) : uk_malloc(a, size);
+  if (!p) {
+    fprintf(stderr, "wilde-stress: %s out of memory after %lu calls\n",
+            r->regime, r->ops);
+    exit(1);
+  }
+
+  r->live_objects++;
+  r->live_bytes += size;
+  run_op(r);
+  return p;
+}
+
+static void run_free(struct run *r, void *p, size_t size)
+{
+  uk_free(a, p);
+  r->live_objects--;
+  r->live_bytes -= size;
+  run_op(r);
+}
+// }}}
+
+// regimes {{{
+static void scale(uint64_t n)
+{
+  void **objs = malloc(n * sizeof(*objs));
+  uint32_t *sizes = malloc(n * sizeof(*sizes));
+  uint32_t *order = malloc(n * sizeof(*order));
+  struct run r;
+
+  if (!objs || !sizes || !order) {
+    perror("malloc");
+    exit(1);
+  }
+
+  run_begin(&r, "scale");
+  for (uint64_t i = 0; i < n; i++) {
+    sizes[i] = 16 + rnd() % 241;
+    objs[i] = run_alloc(&r, 0, sizes[i]);
+    order[i] = i;
+  }
+
+  /* Fisher-Yates, the frees hit the alias table all over */
+  for (uint64_t i = n - 1; i > 0; i--) {
+    uint64_t j = rnd() % (i + 1);
+    uint32_t t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+
+  verify(r.regime, r.ops);
+  for (uint64_t i = 0; i < n; i++)
+    run_free(&r, objs[order[i]], sizes[order[i]]);
+  run_end(&r);
+
+  free(objs);
+  free(sizes);
+  free(order);
+}
+
+static void fragment(uint64_t n)
+{
+  uint64_t slots = n / 16 + 1;
+  void **objs = calloc(slots, sizeof(*objs));
+  uint32_t *sizes = calloc(slots, sizeof(*sizes));
+  struct run r;
+
+  if (!objs || !sizes) {
+    perror("calloc");
+    exit(1);
+  }
+
+  run_begin(&r, "fragment");
+  while (r.ops < n) {
+    uint64_t i = rnd() % slots;
+
+    if (objs[i]) {
+      run_free(&r, objs[i], sizes[i]);
+      objs[i] = NULL;
+    } else {
+      sizes[i] = 16 + rnd() % 4080;
+      objs[i] = run_alloc(&r, 4096UL << (rnd() % 9), sizes[i]);
+    }
+  }
+
+  for (uint64_t i = 0; i < slots; i++)
+    if (objs[i])
+      run_free(&r, objs[i], sizes[i]);
+  run_end(&r);
+
+  free(objs);
+  free(sizes);
+}
+
+static void span(uint64_t n)
+{
+  void *objs[SPAN_LIVE] = {0};
+  size_t sizes[SPAN_LIVE] = {0};
+  struct wilde_stats s;
+  struct run r;
+
+  (void)n;
+  run_begin(&r, "span");
+  for (;;) {
+    unsigned i = rnd() % SPAN_LIVE;
+
+    if (objs[i]) {
+      run_free(&r, objs[i], sizes[i]);
+      objs[i] = NULL;
+      continue;
+    }
+
+    /* stop short of the crash an exhausted window is */
+    wilde_stats_get(&s);
+    if (s.va_remaining < SPAN_RESERVE)
+      break;
+
+    sizes[i] = SPAN_MIN + rnd() % (SPAN_MAX - SPAN_MIN);
+    objs[i] = run_alloc(&r, 0, sizes[i]);
+  }
+
+  for (unsigned i = 0; i < SPAN_LIVE; i++)
+    if (objs[i])
+      run_free(&r, objs[i], sizes[i]);
+  run_end(&r);
+}
+
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+static const size_t hot_sizes[] = {24, 64, 100, 200};
+
+static void hot(uint64_t n)
+{
+  uint64_t slots = n / 16 + 1;
+  void **objs = calloc(slots, sizeof(*objs));
+  uint32_t *sizes = calloc(slots, sizeof(*sizes));
+  struct wilde_stats s;
+  struct run r;
+
+  if (!objs || !sizes) {
+    perror("calloc");
+    exit(1);
+  }
+
+  run_begin(&r, "hot");
+  while (r.ops < n) {
+    uint64_t i = rnd() % slots;
+
+    if (objs[i]) {
+      run_free(&r, objs[i], sizes[i]);
+      objs[i] = NULL;
+    } else {
+      sizes[i] = rnd() % 8 ? hot_sizes[rnd() % 4] : 16 + rnd() % 4080;
+      objs[i] = run_alloc(&r, 0, sizes[i]);
+    }
+
+    /* the background thread, on the host it's up to us */
+    if (r.ops % HOT_REFILL == 0)
+      wilde_magazine_refill();
+  }
+
+  for (uint64_t i = 0; i < slots; i++)
+    if (objs[i])
+      run_free(&r, objs[i], sizes[i]);
+
+  /* what's left in the magazines is mapped, so verify knows about it */
+  run_end(&r);
+
+  wilde_stats_get(&s);
+  fprintf(stderr, "wilde-stress: hot magazines %lu hits, %lu misses, %lu "
+          "prepared\n", s.magazine_hits, s.magazine_misses, s.magazine_objects);
+
+  free(objs);
+  free(sizes);
+}
+#endif
+
+#ifdef CONFIG_LIBWILDE_CACHE
+static void cache(uint64_t n)
+{
+  void *objs[CACHE_SLOTS] = {0};
+  struct wilde_cache *c = wilde_cache_create(CACHE_OBJECT, 0, NULL);
+  struct wilde_stats s;
+  struct run r;
+
+  if (!c) {
+    fprintf(stderr, "wilde-stress: couldn't create a cache\n");
+    exit(1);
+  }
+
+  run_begin(&r, "cache");
+  while (r.ops < n) {
+    unsigned i = rnd() % CACHE_SLOTS;
+
+    if (objs[i]) {
+      wilde_cache_free(c, objs[i]);
+      objs[i] = NULL;
+      r.live_objects--;
+      r.live_bytes -= CACHE_OBJECT;
+    } else {
+      objs[i] = wilde_cache_alloc(c);
+      if (!objs[i]) {
+        fprintf(stderr, "wilde-stress: cache out of memory after %lu calls\n",
+                r.ops);
+        exit(1);
+      }
+      r.live_objects++;
+      r.live_bytes += CACHE_OBJECT;
+    }
+    run_op(&r);
+  }
+
+  for (unsigned i = 0; i < CACHE_SLOTS; i++)
+    if (objs[i]) {
+      wilde_cache_free(c, objs[i]);
+      r.live_objects--;
+      r.live_bytes -= CACHE_OBJECT;
+    }
+  wilde_stats_get(&s);
+  fprintf(stderr, "wilde-stress: cache %lu hits, %lu misses, %lu prepared\n",
+          s.cache_hits, s.cache_misses, s.cache_objects);
+
+  wilde_cache_destroy(c);
+  run_end(&r);
+}
+#endif
+
+#ifdef CONFIG_LIBWILDE_ARENA
+static void arena(uint64_t n)
+{
+  struct run r;
+
+  run_begin(&r, "arena");
+  while (r.ops < n) {
+    struct wilde_arena *ar = wilde_arena_create(ARENA_SIZE);
+    if (!ar) {
+      fprintf(stderr, "wilde-stress: arena out of memory after %lu calls\n",
+              r.ops);
+      exit(1);
+    }
+
+    for (unsigned i = 0; i < ARENA_OBJECTS && r.ops < n; i++) {
+      size_t size = 16 + rnd() % 241;
+      if (!wilde_arena_alloc(ar, size)) {
+        fprintf(stderr, "wilde-stress: arena full after %u objects\n", i);
+        exit(1);
+      }
+
+      r.live_objects++;
+      r.live_bytes += size;
+      run_op(&r);
+    }
+
+    wilde_arena_destroy(ar);
+    r.live_objects = 0;
+    r.live_bytes = 0;
+  }
+  run_end(&r);
+}
+#endif
+
+#ifdef CONFIG_LIBWILDE_SMP
+static unsigned smp_cpu;
+
+/* the host has no other cores to interrupt, it switches to each in turn */
+static void smp_ipi(uint64_t cpus)
+{
+  for (unsigned cpu = 0; cpu < 64; cpu++)
+    if (cpus & (1ULL << cpu)) {
+      wilde_smp_cpu_online(cpu);
+      wilde_smp_shootdown();
+    }
+
+  wilde_smp_cpu_online(smp_cpu);
+}
+
+static void smp_switch(unsigned cpu)
+{
+  smp_cpu = cpu;
+  wilde_smp_cpu_online(cpu);
+}
+
+static void smp(uint64_t n)
+{
+  static char names[SMP_STAGES][8];
+  uint64_t slots = n / 16 + 1;
+  void **objs = calloc(slots, sizeof(*objs));
+  uint32_t *sizes = calloc(slots, sizeof(*sizes));
+  struct wilde_stats before, after;
+  struct run r;
+
+  if (!objs || !sizes) {
+    perror("calloc");
+    exit(1);
+  }
+
+  wilde_smp_ipi_set(smp_ipi);
+
+  for (unsigned stage = 0, cpus = 1;
+       stage < SMP_STAGES && cpus <= CONFIG_LIBWILDE_NR_CPUS;
+       stage++, cpus *= 2) {
+    uint64_t frees = 0, churn_frees = 0, free_ns = 0;
+
+    snprintf(names[stage], sizeof(names[stage]), "smp%u", cpus);
+    wilde_stats_get(&before);
+    run_begin(&r, names[stage]);
+    while (r.ops < n) {
+      uint64_t i = rnd() % slots;
+
+      smp_switch(rnd() % cpus);
+      if (objs[i]) {
+        uint64_t start = now_ns();
+        run_free(&r, objs[i], sizes[i]);
+        free_ns += now_ns() - start;
+        objs[i] = NULL;
+        frees++;
+        churn_frees++;
+      } else {
+        sizes[i] = 16 + rnd() % 241;
+        objs[i] = run_alloc(&r, 0, sizes[i]);
+      }
+    }
+
+    smp_switch(0);
+    for (uint64_t i = 0; i < slots; i++)
+      if (objs[i]) {
+        run_free(&r, objs[i], sizes[i]);
+        objs[i] = NULL;
+        frees++;
+      }
+    run_end(&r);
+
+    wilde_stats_get(&after);
+    fprintf(stderr, "wilde-stress: %s %lu frees, %.2f shootdowns and %.2f "
+            "ipis per free, %lu kfrees/s\n", names[stage], frees,
+            (double)(after.tlb_shootdowns - before.tlb_shootdowns) / frees,
+            (double)(after.tlb_ipis - before.tlb_ipis) / frees,
+            free_ns ? churn_frees * 1000000 / free_ns : 0);
+  }
+
+  free(objs);
+  free(sizes);
+}
+#endif
+
+static const struct {
+  const char *name;
+  void (*run)(uint64_t n);
+} regimes[] = {
+  {"scale", scale},
+  {"fragment", fragment},
+  {"span", span},
+#ifdef CONFIG_LIBWILDE_MAGAZINES
+  {"hot", hot},
+#endif
+#ifdef CONFIG_LIBWILDE_CACHE
+  {"cache", cache},
+#endif
+#ifdef CONFIG_LIBWILDE_ARENA
+  {"arena", arena},
+#endif
+#ifdef CONFIG_LIBWILDE_SMP
+  {"smp", smp},
+#endif
+};
+
+#define NR_REGIMES (sizeof(regimes) / sizeof(regimes[0]))
+
+static int regime_find(const char *name)
+{
+  for (unsigned i = 0; i < NR_REGIMES; i++)
+    if (!strcmp(regimes[i].name, name))
+      return i;
+
+  return -1;
+}
+// }}}
+
+int main(int argc, char **argv)
+{
+  uint64_t seed = 1, n = 1000000;
+  size_t pool_mb = 8192;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:n:w:v:m:")) != -1) {
+    switch (opt) {
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'n':
+      n = strtoull(optarg, NULL, 0);
+      break;
+    case 'w':
+      row_ops = strtoull(optarg, NULL, 0);
+      break;
+    case 'v':
+      verify_rows = strtoull(optarg, NULL, 0);
+      break;
+    case 'm':
+      pool_mb = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      goto usage;
+    }
+  }
+
+  if (!n || !row_ops)
+    goto usage;
+
+  for (int i = optind; i < argc; i++)
+    if (regime_find(argv[i]) < 0)
+      goto usage;
+
+  rng = seed * 0x9e3779b97f4a7c15ULL | 1;
+
+  a = wilde_host_init(pool_mb << 20);
+  if (!a) {
+    fprintf(stderr, "wilde-stress: couldn't set up a %zuMB pool\n", pool_mb);
+    return 1;
+  }
+
+  printf("regime,ops,live_objects,live_bytes,kops_per_s,va_used,pt_pages,"
+         "invlpgs\n");
+
+  /* all of them without arguments */
+  unsigned nr = optind == argc ? NR_REGIMES : (unsigned)(argc - optind);
+  for (unsigned i = 0; i < nr; i++) {
+    int regime = optind == argc ? (int)i : regime_find(argv[optind + i]);
+    regimes[regime].run(n);
+    fflush(stdout);
+  }
+
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-s seed] [-n objects] [-w calls per row] "
+          "[-v rows per verify] [-m pool MB] [scale|fragment|span|hot|cache|arena|smp...]\n",
+          argv[0]);
+  return 1;
+}
@@ -0,0 +1,251 @@
+/*
+ * Host side decoder for the wilde allocation trace
+ *
+ * Reads a console log holding the output of wilde_trace_dump() on stdin and
+ * writes the records, sorted by time stamp, as text or CSV (-c) to stdout, or
+ * converts them into a replay file (-r) for tools/wilde-replay.
+ *
+ *   make tools
+ *   tools/wilde-trace < console.log
+ *   tools/wilde-trace -c < console.log > trace.csv
+ *   tools/wilde-trace -r trace.replay < console.log
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <search.h>
+#include <wilde_trace.h>
+
+/* matches enum wilde_call */
+static const char *const op_names[] = {
+  "malloc", "calloc", "realloc", "posix_memalign", "memalign",
+  "free", "palloc", "pfree", "addmem", "availmem",
+};
+
+#define NR_OPS (sizeof(op_names) / sizeof(op_names[0]))
+
+static int hexval(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+static bool decode(const char *hex, struct wilde_trace_record *rec)
+{
+  unsigned char *bytes = (unsigned char *)rec;
+
+  for (size_t i = 0; i < sizeof(*rec); i++) {
+    int hi = hexval(hex[2 * i]), lo = hexval(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0)
+      return false;
+    bytes[i] = hi << 4 | lo;
+  }
+
+  return true;
+}
+
+static int by_tsc(const void *a, const void *b)
+{
+  const struct wilde_trace_record *x = a, *y = b;
+  return x->tsc < y->tsc ? -1 : x->tsc > y->tsc;
+}
+
+// replay conversion {{{
+/* live objects by address, for turning pointers into ids */
+struct object {
+  uint64_t addr;
+  uint32_t id;
+};
+
+static void *objects;
+
+static int by_addr(const void *a, const void *b)
+{
+  const struct object *x = a, *y = b;
+  return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static uint32_t object_new(uint64_t addr, uint32_t id)
+{
+  struct object *o = malloc(sizeof(*o));
+  *o = (struct object){.addr = addr, .id = id};
+
+  /* an address handed out twice means we missed its free, the new one wins */
+  struct object **found = tsearch(o, &objects, by_addr);
+  if (*found != o) {
+    free(*found);
+    *found = o;
+  }
+
+  return id;
+}
+
+static uint32_t object_del(uint64_t addr)
+{
+  struct object key = {.addr = addr};
+  struct object **found = tfind(&key, &objects, by_addr);
+  if (!found)
+    return 0;
+
+  struct object *o = *found;
+  uint32_t id = o->id;
+  tdelete(&key, &objects, by_addr);
+  free(o);
+  return id;
+}
+
+static uint16_t log2_of(uint64_t x)
+{
+  return x ? 63 - __builtin_clzll(x) : 0;
+}
+
+static int write_replay(const char *path, struct wilde_trace_record *recs,
+                        size_t nr)
+{
+  struct wilde_replay_header h = {
+    .magic = WILDE_REPLAY_MAGIC,
+    .version = WILDE_REPLAY_VERSION,
+  };
+  size_t unmatched = 0;
+  uint32_t next_id = 1;
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  /* header gets rewritten once the counts are known */
+  fwrite(&h, sizeof(h), 1, f);
+
+  for (size_t i = 0; i < nr; i++) {
+    const struct wilde_trace_record *r = &recs[i];
+    uint64_t dtsc = i ? r->tsc - recs[i - 1].tsc : 0;
+    struct wilde_replay_record out = {
+      .size = r->size,
+      .dtsc = dtsc > UINT32_MAX ? UINT32_MAX : dtsc,
+      .op = r->op,
+    };
+
+    switch (r->op) {
+    case WILDE_CALL_MALLOC:
+    case WILDE_CALL_CALLOC:
+      out.id = r->alias ? object_new(r->alias, next_id++) : 0;
+      break;
+
+    case WILDE_CALL_POSIX_MEMALIGN:
+    case WILDE_CALL_MEMALIGN:
+      out.order = log2_of(r->aux);
+      out.id = r->alias ? object_new(r->alias, next_id++) : 0;
+      break;
+
+    case WILDE_CALL_REALLOC:
+      if (r->aux && !(out.old_id = object_del(r->aux)))
+        unmatched++;
+      out.id = r->alias ? object_new(r->alias, next_id++) : 0;
+      break;
+
+    case WILDE_CALL_PALLOC:
+      out.size = 0;
+      out.order = r->aux;
+      out.id = r->alias ? object_new(r->alias, next_id++) : 0;
+      break;
+
+    case WILDE_CALL_FREE:
+    case WILDE_CALL_PFREE:
+      out.size = 0;
+      out.order = r->op == WILDE_CALL_PFREE ? r->aux : 0;
+      if (!(out.id = object_del(r->alias)))
+        unmatched++;
+      break;
+
+    default:
+      continue;
+    }
+
+    fwrite(&out, sizeof(out), 1, f);
+    h.nr++;
+  }
+
+  h.objects = next_id - 1;
+  fseek(f, 0, SEEK_SET);
+  fwrite(&h, sizeof(h), 1, f);
+
+  if (fclose(f)) {
+    perror(path);
+    return 1;
+  }
+
+  if (unmatched)
+    fprintf(stderr, "wilde-trace: %zu frees of objects allocated before the "
+            "trace, they are skipped on replay\n", unmatched);
+
+  return 0;
+}
+// }}}
+
+int main(int argc, char **argv)
+{
+  bool csv = argc > 1 && !strcmp(argv[1], "-c");
+  const char *replay = argc > 2 && !strcmp(argv[1], "-r") ? argv[2] : NULL;
+  struct wilde_trace_record *recs = NULL;
+  size_t nr = 0, cap = 0, bad = 0;
+  char line[4096];
+
+  while (fgets(line, sizeof(line), stdin)) {
+    const char *p = strstr(line, "WTRACE ");
+    if (!p)
+      continue;
+
+    if (nr == cap) {
+      cap = cap ? cap * 2 : 4096;
+      recs = realloc(recs, cap * sizeof(*recs));
+      if (!recs) {
+        perror("realloc");
+        return 1;
+      }
+    }
+
+    if (strlen(p + 7) < 2 * sizeof(*recs) || !decode(p + 7, &recs[nr])) {
+      bad++;
+      continue;
+    }
+
+    nr++;
+  }
+
+  qsort(recs, nr, sizeof(*recs), by_tsc);
+
+  if (bad)
+    fprintf(stderr, "wilde-trace: skipped %zu malformed records\n", bad);
+
+  if (replay) {
+    int res = write_replay(replay, recs, nr);
+    free(recs);
+    return res;
+  }
+
+  if (csv)
+    printf("tsc,cpu,op,size,alias,origin,caller,aux\n");
+
+  for (size_t i = 0; i < nr; i++) {
+    const struct wilde_trace_record *r = &recs[i];
+    const char *op = r->op < NR_OPS ? op_names[r->op] : "?";
+
+    if (csv)
+      printf("%lu,%u,%s,%lu,%#lx,%#lx,%#lx,%#lx\n", r->tsc, r->cpu, op,
+             r->size, r->alias, r->origin, r->caller, r->aux);
+    else
+      printf("+%-12lu cpu%-2u %-14s size=%-8lu alias=%#lx origin=%#lx "
+             "caller=%#lx aux=%#lx\n",
+             r->tsc - recs[0].tsc, r->cpu, op, r->size, r->alias, r->origin,
+             r->caller, r->aux);
+  }
+
+  free(recs);
+  return 0;
+}
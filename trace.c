@@ -0,0 +1,128 @@
+#define COLOR COLOR_WHITE
+
+#include <string.h>
+#include "trace.h"
+#include "util.h"
+
+struct trace_ring trace_rings[WILDE_NR_CPUS];
+static u64 trace_lost;
+
+/* drains are serialised among each other, writers never wait for it */
+static int trace_lock;
+
+static void trace_lock_take(void)
+{
+  while (__atomic_exchange_n(&trace_lock, 1, __ATOMIC_ACQUIRE))
+    __builtin_ia32_pause();
+}
+
+static void trace_lock_drop(void)
+{
+  __atomic_store_n(&trace_lock, 0, __ATOMIC_RELEASE);
+}
+
+/* moves up to max records of one ring into buf, under trace_lock */
+static size_t trace_drain_ring(struct trace_ring *r,
+                               struct wilde_trace_record *buf, size_t max)
+{
+  u64 done = __atomic_load_n(&r->done, __ATOMIC_ACQUIRE);
+  u64 tail = r->tail;
+  size_t n = 0;
+
+  /* anything further back than a ring's worth has been overwritten */
+  if (done - tail > TRACE_ENTRIES) {
+    trace_lost += done - tail - TRACE_ENTRIES;
+    tail = done - TRACE_ENTRIES;
+  }
+
+  while (tail + n < done && n < max) {
+    buf[n] = r->records[(tail + n) & (TRACE_ENTRIES - 1)];
+    n++;
+  }
+
+  /* the owner may have started on the oldest slots again while copying */
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  u64 head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+
+  if (head > tail + TRACE_ENTRIES) {
+    size_t torn = MIN(head - TRACE_ENTRIES - tail, n);
+
+    memmove(buf, buf + torn, (n - torn) * sizeof(*buf));
+    trace_lost += torn;
+    tail += torn;
+    n -= torn;
+  }
+
+  __atomic_store_n(&r->tail, tail + n, __ATOMIC_RELAXED);
+  return n;
+}
+
+size_t wilde_trace_drain(struct wilde_trace_record *buf, size_t max)
+{
+  size_t n = 0;
+
+  trace_lock_take();
+  for (int cpu = 0; cpu < WILDE_NR_CPUS && n < max; cpu++)
+    n += trace_drain_ring(&trace_rings[cpu], buf + n, max - n);
+  trace_lock_drop();
+
+  return n;
+}
+
+uint64_t wilde_trace_lost(void)
+{
+  return trace_lost;
+}
+
+/* prints records hex encoded to the console, a WTRACE line each */
+static void trace_print(const struct wilde_trace_record *recs, size_t n)
+{
+  static const char hex[] = "0123456789abcdef";
+  char line[8 + 2 * sizeof(recs[0]) + 2];
+
+  for (size_t i = 0; i < n; i++) {
+    const u8 *bytes = (const u8 *)&recs[i];
+    char *p = line + 7;
+
+    memcpy(line, "WTRACE ", 7);
+    for (size_t b = 0; b < sizeof(recs[i]); b++) {
+      *p++ = hex[bytes[b] >> 4];
+      *p++ = hex[bytes[b] & 0xf];
+    }
+    *p++ = '\n';
+
+    ukplat_coutk(line, p - line);
+  }
+}
+
+void trace_flush(void)
+{
+  struct wilde_trace_record recs[16];
+  size_t n;
+
+  while ((n = wilde_trace_drain(recs, 16)))
+    trace_print(recs, n);
+}
+
+void trace_flush_local(void)
+{
+  struct trace_ring *r = &trace_rings[wilde_cpu_id()];
+  struct wilde_trace_record recs[16];
+  size_t n;
+
+  do {
+    trace_lock_take();
+    n = trace_drain_ring(r, recs, 16);
+    trace_lock_drop();
+
+    trace_print(recs, n);
+  } while (n);
+}
+
+void wilde_trace_dump(void)
+{
+  hprintf("WTRACE-BEGIN %d %zu\n", WILDE_TRACE_VERSION,
+          sizeof(struct wilde_trace_record));
+  trace_flush();
+  hprintf("WTRACE-END %lu\n", trace_lost);
+}
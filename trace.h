@@ -0,0 +1,92 @@
+#ifndef __WILDE_TRACE_RING_H__
+#define __WILDE_TRACE_RING_H__
+#include <wilde.h>
+#include "percpu.h"
+#include "util.h"
+#include "x86.h"
+
+/*
+ * Allocation trace, a ring of fixed size binary records per CPU.
+ *
+ * Only the owning CPU writes its ring, so recording is a bump of head, a few
+ * stores and a bump of done, no locks or atomic read-modify-writes. When the
+ * ring wraps the oldest records are overwritten, the drain side notices and
+ * counts them as lost. Under CONFIG_LIBWILDE_TRACE_LOSSLESS the caller
+ * empties a full ring with trace_flush_full() after recording instead.
+ *
+ * Any CPU may drain any ring while its owner goes on writing. A drain copies
+ * up to done, then rereads head, copies of slots the owner started writing
+ * again in the meantime are dropped as lost, like a seqlock reader retrying.
+ */
+
+#ifdef CONFIG_LIBWILDE_TRACE
+
+#define TRACE_ENTRIES CONFIG_LIBWILDE_TRACE_ENTRIES
+
+#if (TRACE_ENTRIES & (TRACE_ENTRIES - 1))
+#error "CONFIG_LIBWILDE_TRACE_ENTRIES has to be a power of 2"
+#endif
+
+struct trace_ring {
+  u64 head; /* records ever started */
+  u64 done; /* records ever written completely */
+  u64 tail; /* records ever drained (or lost) */
+  struct wilde_trace_record records[TRACE_ENTRIES];
+};
+
+extern struct trace_ring trace_rings[WILDE_NR_CPUS];
+
+/* prints and drains all rings to the console */
+void trace_flush(void);
+
+/*
+ * the same for the calling CPU's ring only, which no other CPU writes to, so
+ * it has room once this returns
+ */
+void trace_flush_local(void);
+
+#ifdef CONFIG_LIBWILDE_TRACE_LOSSLESS
+/*
+ * empties the calling CPU's ring to the console once it's full, so the next
+ * record has room. It waits for drains on other CPUs and prints, so it's only
+ * called with the allocator lock dropped, never from within trace_record()
+ */
+static inline void trace_flush_full(void)
+{
+  struct trace_ring *r = &PERCPU(trace_rings);
+
+  if (r->head - __atomic_load_n(&r->tail, __ATOMIC_RELAXED) >= TRACE_ENTRIES)
+    trace_flush_local();
+}
+#else
+static inline void trace_flush_full(void) {}
+#endif
+
+static inline void trace_record(u32 op, size_t size, const void *alias,
+                                const void *origin, const void *caller, u64 aux)
+{
+  unsigned cpu = wilde_cpu_id();
+  struct trace_ring *r = &trace_rings[cpu];
+  u64 head = r->head;
+
+  /* a drain copying the slot has to see it's being overwritten */
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  r->records[head & (TRACE_ENTRIES - 1)] = (struct wilde_trace_record){
+    .tsc = rdtsc(),
+    .size = size,
+    .alias = (uintptr_t)alias,
+    .origin = (uintptr_t)origin,
+    .caller = (uintptr_t)caller,
+    .aux = aux,
+    .op = op,
+    .cpu = cpu,
+  };
+
+  __atomic_store_n(&r->done, head + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* CONFIG_LIBWILDE_TRACE */
+
+#endif /* __WILDE_TRACE_RING_H__ */
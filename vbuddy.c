@@ -0,0 +1,128 @@
+#define COLOR COLOR_CYAN
+
+#include <uk/assert.h>
+#include <uk/list.h>
+#include "vbuddy.h"
+#include "vma.h"
+#include "aslr.h"
+#include "stats.h"
+#include "util.h"
+
+static struct uk_list_head vbuddy_free[VBUDDY_ORDERS];
+static uintptr_t vbuddy_cursor; /* everything from here on is untouched */
+static uintptr_t vbuddy_end;
+static size_t vbuddy_free_bytes; /* bytes sitting in the free lists */
+
+static void vbuddy_push(uintptr_t addr, size_t order)
+{
+  struct vma *v = vma_alloc();
+  v->addr = addr;
+  v->size = __PAGE_SIZE << order;
+
+  uk_list_add(&v->list, &vbuddy_free[order]);
+  vbuddy_free_bytes += v->size;
+}
+
+static uintptr_t vbuddy_pop(size_t order)
+{
+  struct vma *v = uk_list_first_entry(&vbuddy_free[order], struct vma, list);
+  uintptr_t addr = v->addr;
+
+  uk_list_del(&v->list);
+  vma_free(v);
+  vbuddy_free_bytes -= __PAGE_SIZE << order;
+
+  return addr;
+}
+
+/* chops [from, to) into the largest naturally aligned blocks it holds */
+static void vbuddy_release_gap(uintptr_t from, uintptr_t to)
+{
+  while (from < to) {
+    size_t order = __builtin_ctzl(from) - __PAGE_SHIFT;
+    if (order > VBUDDY_MAX_ORDER)
+      order = VBUDDY_MAX_ORDER;
+
+    while (from + (__PAGE_SIZE << order) > to)
+      order--;
+
+    vbuddy_push(from, order);
+    from += __PAGE_SIZE << order;
+  }
+}
+
+void vbuddy_init(uintptr_t start, size_t size)
+{
+  dprintf("vbuddy window %#lx-%#lx\n", start, start + size);
+  UK_ASSERT((start & (__PAGE_SIZE - 1)) == 0);
+
+  for (int i = 0; i < VBUDDY_ORDERS; i++)
+    UK_INIT_LIST_HEAD(&vbuddy_free[i]);
+
+  vbuddy_cursor = start;
+  vbuddy_end = start + size;
+  vbuddy_free_bytes = 0;
+
+#ifdef CONFIG_LIBWILDE_ASLR
+  /* everything goes on the free lists, so every block comes out of a split */
+  vbuddy_release_gap(vbuddy_cursor, vbuddy_end);
+  vbuddy_cursor = vbuddy_end;
+#endif
+}
+
+uintptr_t vbuddy_alloc(size_t order)
+{
+  UK_ASSERT(order <= VBUDDY_MAX_ORDER);
+  STAT_ORDER(va_orders, order);
+
+  /* smallest free block that fits, split down to size */
+  for (size_t o = order; o < VBUDDY_ORDERS; o++) {
+    if (uk_list_empty(&vbuddy_free[o]))
+      continue;
+
+    uintptr_t addr = vbuddy_pop(o);
+
+    /*
+     * keep the lower half, the upper halves go on the free lists. Under ASLR
+     * a random half, a random bit per split.
+     */
+#ifdef CONFIG_LIBWILDE_ASLR
+    u64 bits = o > order ? aslr_rand() : 0;
+#endif
+    while (o > order) {
+      o--;
+#ifdef CONFIG_LIBWILDE_ASLR
+      uintptr_t half = addr + (__PAGE_SIZE << o);
+      if (bits & POW2(o)) {
+        vbuddy_push(addr, o);
+        addr = half;
+      } else {
+        vbuddy_push(half, o);
+      }
+#else
+      vbuddy_push(addr + (__PAGE_SIZE << o), o);
+#endif
+    }
+
+    dprintf("vbuddy_alloc(%zu) => %#lx [free list]\n", order, addr);
+    return addr;
+  }
+
+  /* nothing free, take it from the untouched part of the window */
+  size_t size = __PAGE_SIZE << order;
+  uintptr_t aligned = ROUNDUP(vbuddy_cursor, size);
+
+  if (aligned + size > vbuddy_end)
+    return 0;
+
+  vbuddy_release_gap(vbuddy_cursor, aligned);
+  vbuddy_cursor = aligned + size;
+
+  dprintf("vbuddy_alloc(%zu) => %#lx [cursor]\n", order, aligned);
+  return aligned;
+}
+
+size_t vbuddy_remaining(void)
+{
+  return (vbuddy_end - vbuddy_cursor) + vbuddy_free_bytes;
+}
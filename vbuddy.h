@@ -0,0 +1,43 @@
+#ifndef __WILDE_VBUDDY_H__
+#define __WILDE_VBUDDY_H__
+#include <stdint.h>
+#include <uk/list.h>
+#include "util.h"
+
+/*
+ * Buddy style allocator for virtual address space, used for palloc.
+ *
+ * Page allocations (thread stacks, netbufs, ...) want their alias aligned to
+ * their own size. Carving those out of the first fit vmem_free list leaves
+ * holes nothing else fits in, so they get their own window instead.
+ *
+ * Since wilde never hands out a virtual range twice, blocks are never given
+ * back and never have to coalesce. What remains is:
+ *   - a bump cursor through the window
+ *   - per order free lists holding the naturally aligned leftovers we skipped
+ *     over to align the cursor, or split off of larger blocks
+ *
+ * The free blocks are kept in struct vma's. Under ASLR the whole window starts
+ * out on the free lists and splits keep a random half.
+ */
+
+/* __PAGE_SIZE << VBUDDY_MAX_ORDER covers 1TB */
+#define VBUDDY_MAX_ORDER 28
+#define VBUDDY_ORDERS (VBUDDY_MAX_ORDER + 1)
+
+/*
+ * sets up the window [start, start + size), start should be aligned to the
+ * largest order that will be requested
+ */
+void vbuddy_init(uintptr_t start, size_t size);
+
+/*
+ * @success: returns a range of __PAGE_SIZE << order bytes, aligned to its size
+ * @fail:    returns 0 when the window has run out
+ */
+uintptr_t vbuddy_alloc(size_t order);
+
+/* bytes still available in the window, free lists included */
+size_t vbuddy_remaining(void);
+
+#endif /* __WILDE_VBUDDY_H__ */
@@ -1,18 +1,55 @@
 #include "shimming.h"
 #include "vma.h"
+#include "batch.h"
+#include "stats.h"
 
 static UK_LIST_HEAD(freelist);
+static UK_LIST_HEAD(batches);
+
+static inline void vma_wipe(struct vma *v)
+{
+  *v = (struct vma){.size = 0xaa55aa55, .addr = 0x55aa11aa, .list = UK_LIST_HEAD_INIT(v->list)};
+  uk_list_add(&v->list, &freelist);
+}
 
 static void vma_batch_alloc(void)
 {
   dprintf("Allocating a new batch of vma structs\n");
-  struct vma *vmas = shimmed->palloc(shimmed, 1);
-  size_t nr_vmas = (__PAGE_SIZE << 1) / sizeof(struct vma);
+  struct batch *b = shimmed->palloc(shimmed, BATCH_ORDER);
+  struct vma *vmas = BATCH_FIRST(b, struct vma);
+
+  UK_ASSERT(b);
+  UK_ASSERT(batch_of(b) == b);
+  STAT_METADATA_PAGES(POW2(BATCH_ORDER));
 
-  UK_ASSERT(vmas);
+  b->used = 0;
+  uk_list_add(&b->list, &batches);
 
-  for (unsigned i = 0; i < nr_vmas; i++)
-    vma_free(&vmas[i]);
+  for (unsigned i = 0; i < BATCH_ENTRIES(struct vma); i++)
+    vma_wipe(&vmas[i]);
+}
+
+size_t vma_shrink(void)
+{
+  struct batch *b, *next;
+  size_t pages = 0;
+
+  uk_list_for_each_entry_safe(b, next, &batches, list) {
+    if (b->used)
+      continue;
+
+    /* all of them are on the freelist */
+    struct vma *vmas = BATCH_FIRST(b, struct vma);
+    for (unsigned i = 0; i < BATCH_ENTRIES(struct vma); i++)
+      uk_list_del(&vmas[i].list);
+
+    uk_list_del(&b->list);
+    shimmed->pfree(shimmed, b, BATCH_ORDER);
+    STAT_METADATA_PAGES(-POW2(BATCH_ORDER));
+    pages += POW2(BATCH_ORDER);
+  }
+
+  return pages;
 }
 
 struct vma *vma_alloc()
@@ -26,6 +63,7 @@ struct vma *vma_alloc()
 
   last->size = 0;
   last->addr = 0;
+  batch_of(last)->used++;
 
   dprintf("allocating a new vma: %p\n", last);
   return last;
@@ -34,8 +72,8 @@ struct vma *vma_alloc()
 void vma_free(struct vma *v)
 {
   // dprintf("vma_free(%p)\n", v);
-  *v = (struct vma){.size = 0xaa55aa55, .addr = 0x55aa11aa, .list = UK_LIST_HEAD_INIT(v->list)};
-  uk_list_add(&v->list, &freelist);
+  batch_of(v)->used--;
+  vma_wipe(v);
 }
 
 struct vma *vma_split(struct vma *v, uintptr_t addr)
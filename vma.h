@@ -30,6 +30,12 @@ struct vma *vma_alloc();
  */
 void vma_free(struct vma *free);
 
+/*
+ * gives the batches of which no vma is in use back to the backing allocator,
+ * returns the pages released
+ */
+size_t vma_shrink(void);
+
 /******************************************************************************
  * VMA struct joining/splitting                                               *
  *****************************************************************************/
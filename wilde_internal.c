@@ -18,23 +18,32 @@
 #include "pagetables.h"
 #include "alias.h"
 #include "vma.h"
+#include "vbuddy.h"
+#include "aslr.h"
+#include "arena.h"
+#ifdef CONFIG_LIBWILDE_RECLAIM
+#include "reclaim.h"
+#endif
+#ifdef CONFIG_LIBWILDE_RELEASE
+#include <string.h>
+#include <errno.h>
+#include "kallocs_malloc.h"
+#endif
+#include "policy.h"
+#include "stats.h"
+#include "latency.h"
+#include "profile.h"
 #include "shimming.h"
 #include "util.h"
 #include "x86.h"
 
 
-
-#define VMAP_START ((4 * TB))
-#define VMAP_SIZE  ((3 * TB))
-
 /* define lists */
 UK_LIST_HEAD(vmem_free);
 UK_LIST_HEAD(vmem_gc);
 
-#ifdef CONFIG_LIBWILDE_ASLR
-/* define random generator */
-struct uk_swrand wilde_rand;
-#endif
+/* bytes in vmem_free, kept up to date so stats needn't walk it */
+static size_t vmem_free_bytes;
 
 static void print_sz(size_t size)
 {
@@ -62,12 +71,17 @@ void wilde_map_init(void)
 {
   dprintf("Initialising the vmem structs\n");
 
+#ifdef CONFIG_LIBWILDE_ASLR
+  /* the regions take over the malloc window, vmem_free stays empty */
+  aslr_init(VMAP_START, VMAP_SIZE - VMAP_PALLOC_SIZE);
+#else
   struct vma *initial = vma_alloc();
   *initial = (struct vma){.addr = VMAP_START,
-                          .size = VMAP_SIZE,
+                          .size = VMAP_SIZE - VMAP_PALLOC_SIZE,
                           .list = UK_LIST_HEAD_INIT(initial->list)};
 
   uk_list_add_tail(&initial->list, &vmem_free);
+  vmem_free_bytes = initial->size;
 
   dprintf("Let's see if it was added:\n");
   struct vma *iter;
@@ -75,37 +89,48 @@ void wilde_map_init(void)
   {
     dprintf(" -> vma {.addr=%p, .size=%zu}\n", (void *)iter->addr, iter->size);
   }
+#endif
+
+  vbuddy_init(VMAP_PALLOC_START, VMAP_PALLOC_SIZE);
 }
 
-void *wilde_map_new(void *real_addr, size_t size, size_t alignment)
+/* the amount of virtual memory reserved for map_size mapped bytes */
+static size_t wilde_reserved_size(size_t map_size)
 {
-  dprintf("wilde_map_new(addr=%p, size=%zu, alignment=%zu)\n", real_addr, size, alignment);
-  /* calculate start and end of page range in which the original allocation
-   * falls */
-  uintptr_t page_start = ROUNDDOWN(((uintptr_t)real_addr), __PAGE_SIZE);
-  uintptr_t page_end = ROUNDUP((uintptr_t)(real_addr + size), __PAGE_SIZE);
-
-  /* calculate internal VMAP_START and required map size */
-  size_t offset = ((uintptr_t)real_addr) - page_start;
-  size_t map_size = page_end - page_start;
-
   #ifndef CONFIG_LIBWILDE_SHAUN
-    size_t reserved_size = map_size;
+    return map_size;
   #elif CONFIG_LIBWILDE_BLACKSHEEP
     #warning "Extreme memory wastage, use at your own peril"
 
     /* black sheep is extreme quarantine mode, we must stop the spread! reserve massive chunks of blank space */
-    size_t reserved_size = map_size * 2 + __PAGE_SIZE;
+    return map_size * 2 + __PAGE_SIZE;
   #else
     /* in case of shaun, we need an additional available page */
-    size_t reserved_size = map_size + __PAGE_SIZE;
+    return map_size + __PAGE_SIZE;
   #endif
+}
 
+/*
+ * takes reserved_size bytes aligned to alignment out of vmem_free, or out of
+ * a random region under ASLR
+ *
+ * @success: returns the start of the reserved range
+ * @fail:    returns 0
+ */
+static uintptr_t vmem_reserve(size_t reserved_size, size_t alignment)
+{
+#ifdef CONFIG_LIBWILDE_ASLR
+  LAT_BEGIN(draw);
+  uintptr_t addr = aslr_reserve(reserved_size, alignment);
+  LAT_END(WILDE_PHASE_VMEM_WALK, draw);
+  return addr;
+#else
   struct vma *iter, *next;
   // struct uk_list_head next;
 
   /* Assert we have any freelist */
   UK_ASSERT(!uk_list_empty(&vmem_free));
+  LAT_BEGIN(walk);
 
   // dprintf("Going to loop over all vmem_free entries:\n");
 
@@ -113,31 +138,15 @@ void *wilde_map_new(void *real_addr, size_t size, size_t alignment)
   {
     dprintf(" -> free vma {.addr=%p, .size=%zu}\n", (void *)iter->addr, iter->size);
 
-#ifdef CONFIG_LIBWILDE_ASLR
-    /* randomisation implemented by calculating the offset into a specific vma */
-    uintptr_t first = ROUNDUP(iter->addr, alignment);
-    uintptr_t last  = ROUNDDOWN((iter->addr + iter->size) - reserved_size, alignment);
-
-    /* short circuit out the invalid options */
-    if (last < first)
-      continue;
-
-    uintptr_t slots = (last - first) / alignment;
-
-    /* pick a random number in [0, slots] */
-    uintptr_t slot = uk_swrand_randr_r(&wilde_rand) % (slots + 1);
-    uintptr_t aligned = first + slot * alignment;
-    dprintf("Going to use ASLR allocating space of %ld in [%#lx, %#lx, %lu] number of choices: %lu => %lx\n",
-    reserved_size, iter->addr, iter->addr+iter->size, alignment, slots + 1, aligned);
-#else
     uintptr_t aligned = ROUNDUP(iter->addr, alignment);
-#endif
     ssize_t remaining = iter->size - (aligned - iter->addr);
 
 
 
     /* can create an aligned allocation */
     if (remaining >= (ssize_t) reserved_size) {
+      LAT_END(WILDE_PHASE_VMEM_WALK, walk);
+      LAT_BEGIN(split);
 
       /* Cut off bit before */
       if (aligned != iter->addr) {
@@ -148,6 +157,7 @@ void *wilde_map_new(void *real_addr, size_t size, size_t alignment)
         if (tmp->size == __PAGE_SIZE) {
           uk_list_del(&tmp->list);
           vma_free(tmp);
+          vmem_free_bytes -= __PAGE_SIZE;
         }
 #else
         iter = vma_split(iter, aligned);
@@ -162,30 +172,97 @@ void *wilde_map_new(void *real_addr, size_t size, size_t alignment)
         if (tmp->size == __PAGE_SIZE) {
           uk_list_del(&tmp->list);
           vma_free(tmp);
+          vmem_free_bytes -= __PAGE_SIZE;
         }
 #endif
       }
 
       UK_ASSERT(aligned == iter->addr);
       UK_ASSERT(reserved_size == iter->size);
+      LAT_END(WILDE_PHASE_VMA_SPLIT, split);
 
       /* remove vma from vmem_free list */
       uk_list_del_init(&iter->list);
-
-      /* register the alias in our quick lookup */
-      alias_register((uintptr_t)real_addr, iter->addr + offset, size);
-
-      /* remap the memory range */
-      remap_range((void *)page_start, (void *) aligned, map_size);
+      vmem_free_bytes -= reserved_size;
 
       /* free the vma struct pointer */
       vma_free(iter);
 
-      // return real_addr;
-      return (void *)(aligned + offset);
+      return aligned;
     }
   }
 
+  LAT_END(WILDE_PHASE_VMEM_WALK, walk);
+  return 0;
+#endif
+}
+
+size_t vmem_remaining(void)
+{
+#ifdef CONFIG_LIBWILDE_ASLR
+  return aslr_remaining();
+#else
+  return vmem_free_bytes;
+#endif
+}
+
+uintptr_t wilde_map_reserve(size_t size)
+{
+  return vmem_reserve(wilde_reserved_size(ROUNDUP(size, __PAGE_SIZE)),
+                      __PAGE_SIZE);
+}
+
+/*
+ * registers the alias of real_addr at the reserved range starting at aligned
+ * and maps it in
+ */
+static void *wilde_map_commit(void *real_addr, size_t size, uintptr_t aligned)
+{
+  /* calculate start and end of page range in which the original allocation
+   * falls */
+  uintptr_t page_start = ROUNDDOWN(((uintptr_t)real_addr), __PAGE_SIZE);
+  uintptr_t page_end = ROUNDUP((uintptr_t)(real_addr + size), __PAGE_SIZE);
+  size_t offset = ((uintptr_t)real_addr) - page_start;
+
+  /* register the alias in our quick lookup */
+  LAT_BEGIN(reg);
+  alias_register((uintptr_t)real_addr, aligned + offset, size);
+  LAT_END(WILDE_PHASE_ALIAS_REGISTER, reg);
+  STAT_LIVE_ADD(aligned + offset, size);
+
+  /* remap the memory range */
+  LAT_BEGIN(remap);
+  remap_range((void *)page_start, (void *) aligned, page_end - page_start);
+  LAT_END(WILDE_PHASE_REMAP, remap);
+
+#ifdef CONFIG_LIBWILDE_RECLAIM
+  reclaim_tick();
+#endif
+
+  return (void *)(aligned + offset);
+}
+
+static void *wilde_map_new_internal(void *real_addr, size_t size, size_t alignment, bool guard)
+{
+  dprintf("wilde_map_new(addr=%p, size=%zu, alignment=%zu, guard=%d)\n", real_addr, size, alignment, guard);
+  /* calculate start and end of page range in which the original allocation
+   * falls */
+  uintptr_t page_start = ROUNDDOWN(((uintptr_t)real_addr), __PAGE_SIZE);
+  uintptr_t page_end = ROUNDUP((uintptr_t)(real_addr + size), __PAGE_SIZE);
+
+  /* calculate required map size */
+  size_t map_size = page_end - page_start;
+
+  size_t reserved_size = wilde_reserved_size(map_size);
+
+  /* a guard page might already be there because of SHAUN */
+  if (guard && reserved_size == map_size)
+    reserved_size += __PAGE_SIZE;
+
+  uintptr_t aligned = vmem_reserve(reserved_size, alignment);
+  if (aligned)
+    return wilde_map_commit(real_addr, size, aligned);
+
   uk_pr_crit("couldn't alloc virtual memory chunk of ");
   print_sz(map_size);
   uk_pr_crit(" aligned to a size of ");
@@ -195,13 +272,235 @@ void *wilde_map_new(void *real_addr, size_t size, size_t alignment)
   return NULL;
 }
 
-void *wilde_map_rm(void *map_addr, size_t *out_size)
+void *wilde_map_new(void *real_addr, size_t size, size_t alignment)
+{
+  return wilde_map_new_internal(real_addr, size, alignment, false);
+}
+
+void *wilde_map_new_guard(void *real_addr, size_t size, size_t alignment)
+{
+  return wilde_map_new_internal(real_addr, size, alignment, true);
+}
+
+void *wilde_map_new_palloc(void *real_addr, size_t order)
+{
+  dprintf("wilde_map_new_palloc(addr=%p, order=%zu)\n", real_addr, order);
+  size_t size = __PAGE_SIZE << order;
+
+  /* guard pages bump us up an order, which only costs virtual memory */
+  size_t reserved_size = wilde_reserved_size(size);
+  size_t vorder = order;
+  while ((__PAGE_SIZE << vorder) < reserved_size)
+    vorder++;
+
+  LAT_BEGIN(vbuddy);
+  uintptr_t aligned = vorder <= VBUDDY_MAX_ORDER ? vbuddy_alloc(vorder) : 0;
+  LAT_END(WILDE_PHASE_VBUDDY, vbuddy);
+  if (aligned)
+    return wilde_map_commit(real_addr, size, aligned);
+
+  uk_pr_crit("couldn't alloc virtual memory chunk of ");
+  print_sz(size);
+  uk_pr_crit(" in the palloc window\n");
+  UK_CRASH("My life is over\n");
+  return NULL;
+}
+
+#ifdef CONFIG_LIBWILDE_RELEASE
+#ifndef CONFIG_LIBWILDE_KELLOGS
+  #error "Releasing pages needs the block layout of kallocs, LIBWILDE_KELLOGS"
+#endif
+
+/* gives the page aligned [phys, phys + size) back in naturally aligned blocks */
+static void phys_free(uintptr_t phys, size_t size)
+{
+  while (size) {
+    size_t order = 0;
+    while (!(phys & ((__PAGE_SIZE << (order + 1)) - 1)) &&
+           (__PAGE_SIZE << (order + 1)) <= size)
+      order++;
+
+    shimmed->pfree(shimmed, (void *)phys, order);
+    phys += __PAGE_SIZE << order;
+    size -= __PAGE_SIZE << order;
+  }
+}
+
+/*
+ * unmaps what's mapped of [start, end) and gives the memory behind it back,
+ * a physically contiguous run at a time, the memory only goes once no TLB
+ * can reach it anymore. Returns the bytes given back
+ */
+static size_t map_punch(uintptr_t start, uintptr_t end)
+{
+  size_t freed = 0;
+
+  for (uintptr_t page = start; page < end;) {
+    uintptr_t phys = pt_get_phys(page);
+    if (!phys) {
+      page += __PAGE_SIZE;
+      continue;
+    }
+
+    uintptr_t run = page + __PAGE_SIZE;
+    while (run < end && pt_get_phys(run) == phys + (run - page))
+      run += __PAGE_SIZE;
+
+    unmap_range((void *)page, run - page);
+    phys_free(phys, run - page);
+    freed += run - page;
+    page = run;
+  }
+
+  return freed;
+}
+
+/*
+ * tears a released mapping down: what's still mapped goes with map_punch,
+ * the parts of its kallocs block in front of and behind the alias directly
+ */
+static void map_pieces_free(const struct alias *a)
+{
+  uintptr_t page_start = ROUNDDOWN(a->alias, __PAGE_SIZE);
+  uintptr_t page_end = ROUNDUP(a->alias + a->size, __PAGE_SIZE);
+  uintptr_t origin = ROUNDDOWN(a->origin, __PAGE_SIZE);
+
+  size_t block_size = kallocs_block_size(a->size);
+  uintptr_t block = ROUNDDOWN(a->origin, block_size);
+
+  map_punch(page_start, page_end);
+  phys_free(block, origin - block);
+  phys_free(origin + (page_end - page_start),
+            block + block_size - origin - (page_end - page_start));
+}
+
+/*
+ * the malloc & co alias at map_addr and the pages [start, end) of it the
+ * range [off, off + len) covers, whole pages only or every page it touches
+ */
+static struct alias *map_range(void *map_addr, size_t off, size_t len,
+                               bool whole, uintptr_t *start, uintptr_t *end)
+{
+  struct alias *a = (struct alias *)alias_search((uintptr_t)map_addr);
+
+  if (!a || a->alias >= VMAP_PALLOC_START || (a->flags & ALIAS_FOREIGN) ||
+      off + len < off || off + len > wilde_usable(a->alias, a->size))
+    return NULL;
+
+  uintptr_t from = a->alias + off;
+  uintptr_t to = from + len;
+  *start = whole ? ROUNDUP(from, __PAGE_SIZE) : ROUNDDOWN(from, __PAGE_SIZE);
+  *end = whole ? ROUNDDOWN(to, __PAGE_SIZE) : ROUNDUP(to, __PAGE_SIZE);
+  return a;
+}
+
+ssize_t wilde_map_release(void *map_addr, size_t off, size_t len)
+{
+  uintptr_t start, end;
+  struct alias *a = map_range(map_addr, off, len, true, &start, &end);
+  if (!a)
+    return -EINVAL;
+
+  if (start >= end)
+    return 0;
+
+  a->flags |= ALIAS_RELEASED;
+  return map_punch(start, end);
+}
+
+ssize_t wilde_map_recommit(void *map_addr, size_t off, size_t len)
+{
+  uintptr_t start, end;
+  if (!map_range(map_addr, off, len, false, &start, &end))
+    return -EINVAL;
+
+  /* unmapped runs are filled with the largest blocks that fit */
+  size_t mapped = 0;
+  for (uintptr_t page = start; page < end;) {
+    if (pt_get_phys(page)) {
+      page += __PAGE_SIZE;
+      continue;
+    }
+
+    size_t run = __PAGE_SIZE;
+    while (page + run < end && !pt_get_phys(page + run))
+      run += __PAGE_SIZE;
+
+    while (run) {
+      size_t order = LOG2(run / __PAGE_SIZE);
+      void *phys;
+
+      while (!(phys = shimmed->palloc(shimmed, order)))
+        if (order-- == 0)
+          return -ENOMEM;
+
+      STAT_ORDER(buddy_orders, order);
+      memset(phys, 0, __PAGE_SIZE << order);
+      remap_range(phys, (void *)page, __PAGE_SIZE << order);
+
+      page += __PAGE_SIZE << order;
+      run -= __PAGE_SIZE << order;
+      mapped += __PAGE_SIZE << order;
+    }
+  }
+
+  return mapped;
+}
+
+bool wilde_map_released(void *map_addr)
+{
+  const struct alias *a = alias_search((uintptr_t)map_addr);
+  return a && (a->flags & ALIAS_RELEASED);
+}
+
+void wilde_map_copy(void *dst, void *map_addr, size_t size)
+{
+  const struct alias *a = alias_search((uintptr_t)map_addr);
+  UK_ASSERT(a);
+
+  /* page by page from the memory behind it, it's scattered by now */
+  size = MIN(size, wilde_usable(a->alias, a->size));
+  for (uintptr_t src = a->alias; size;) {
+    size_t chunk = MIN(size, ROUNDDOWN(src, __PAGE_SIZE) + __PAGE_SIZE - src);
+    uintptr_t phys = pt_get_phys(src);
+
+    if (phys)
+      memcpy(dst, (void *)phys, chunk);
+    else
+      memset(dst, 0, chunk);
+
+    dst = (char *)dst + chunk;
+    src += chunk;
+    size -= chunk;
+  }
+}
+#endif
+
+static void *wilde_map_rm_internal(void *map_addr, bool sized, size_t size,
+                                   bool foreign, size_t *out_size)
 {
   dprintf("Removing allocation at %p\n", map_addr);
+  LAT_BEGIN(search);
   const struct alias *result = alias_search((uintptr_t)map_addr);
+  LAT_END(WILDE_PHASE_ALIAS_SEARCH, search);
   if (result == NULL)
     return NULL;
 
+#ifdef CONFIG_LIBWILDE_FOREIGN
+  /* foreign memory was never allocated, it can't be freed either */
+  if (!!(result->flags & ALIAS_FOREIGN) != foreign)
+    return NULL;
+#else
+  UNUSED(foreign);
+#endif
+
+  if (sized && (size < result->size ||
+                size > wilde_usable(result->alias, result->size))) {
+    dprintf("Size %zu doesn't match {.alias=%p, .size=%ld}\n", size,
+            (void *)result->alias, result->size);
+    return NULL;
+  }
+
   dprintf("Found an alias mapping at {.alias=%p, .origin=%p, .size=%ld}\n",
           (void *)result->alias, (void *)result->origin, result->size);
 
@@ -217,12 +516,137 @@ void *wilde_map_rm(void *map_addr, size_t *out_size)
   /* calculate internal VMAP_START and required map size */
   size_t map_size = page_end - page_start;
 
+  /* foreign aliases were never counted live nor sampled */
+  if (!foreign) {
+    STAT_LIVE_SUB(result->alias, result->size);
+    PROFILE_FREE(result);
+  }
+
+#ifdef CONFIG_LIBWILDE_RELEASE
+  /* its block is in pieces, given back here rather than by the caller */
+  if (result->flags & ALIAS_RELEASED) {
+    LAT_BEGIN(unmap);
+    map_pieces_free(result);
+    LAT_END(WILDE_PHASE_UNMAP, unmap);
+
+    LAT_BEGIN(unreg);
+    alias_release(result);
+    LAT_END(WILDE_PHASE_ALIAS_UNREGISTER, unreg);
+    return WILDE_MAP_FREED;
+  }
+#endif
+
+  LAT_BEGIN(unmap);
+#ifdef CONFIG_LIBWILDE_RECLAIM
+  /* huge ones are cut off at the top, their tables freed bit by bit */
+  if (map_size >= RECLAIM_THRESHOLD) {
+    reclaim_unmap(page_start, map_size);
+  } else {
+    unmap_range((void *)page_start, map_size);
+    reclaim_tick();
+  }
+#else
   unmap_range((void *)page_start, map_size);
-  alias_unregister((uintptr_t)map_addr);
+#endif
+  LAT_END(WILDE_PHASE_UNMAP, unmap);
+
+  LAT_BEGIN(unreg);
+  alias_release(result);
+  LAT_END(WILDE_PHASE_ALIAS_UNREGISTER, unreg);
 
   return real_addr;
 }
 
+void *wilde_map_rm(void *map_addr, size_t *out_size)
+{
+  return wilde_map_rm_internal(map_addr, false, 0, false, out_size);
+}
+
+void *wilde_map_rm_sized(void *map_addr, size_t size, size_t *out_size)
+{
+  return wilde_map_rm_internal(map_addr, true, size, false, out_size);
+}
+
+#ifdef CONFIG_LIBWILDE_FOREIGN
+/*
+ * the physical address behind [buf, buf + len), which is either identity
+ * mapped memory or an alias of physically contiguous memory, 0 otherwise
+ */
+static uintptr_t foreign_phys(const void *buf, size_t len)
+{
+  uintptr_t va = (uintptr_t)buf;
+
+  if (!wilde_is_alias(buf))
+    return PT_IS_PHYS(va) && PT_IS_PHYS(va + len - 1) ? va : 0;
+
+  uintptr_t phys = pt_get_phys(va);
+  if (!phys)
+    return 0;
+
+  uintptr_t first = ROUNDDOWN(va, __PAGE_SIZE);
+  for (uintptr_t page = first + __PAGE_SIZE; page < va + len;
+       page += __PAGE_SIZE)
+    if (pt_get_phys(page) != ROUNDDOWN(phys, __PAGE_SIZE) + (page - first))
+      return 0;
+
+  return phys;
+}
+
+void *wilde_map_new_foreign(const void *buf, size_t len)
+{
+  if (!len || (uintptr_t)buf + len < (uintptr_t)buf)
+    return NULL;
+
+  uintptr_t phys = foreign_phys(buf, len);
+  if (!phys)
+    return NULL;
+
+  /* not wilde_map_new, running out of window isn't fatal here */
+  uintptr_t page_start = ROUNDDOWN(phys, __PAGE_SIZE);
+  size_t map_size = ROUNDUP(phys + len, __PAGE_SIZE) - page_start;
+  uintptr_t aligned = vmem_reserve(wilde_reserved_size(map_size), __PAGE_SIZE);
+  if (!aligned)
+    return NULL;
+
+  /* nothing was allocated, so it isn't live memory either */
+  uintptr_t alias = aligned + (phys - page_start);
+  alias_register(phys, alias, len);
+  struct alias *a = (struct alias *)alias_search(alias);
+  UK_ASSERT(a);
+  a->flags |= ALIAS_FOREIGN;
+
+  LAT_BEGIN(remap);
+  remap_range((void *)page_start, (void *)aligned, map_size);
+  LAT_END(WILDE_PHASE_REMAP, remap);
+
+  return (void *)alias;
+}
+
+void *wilde_map_rm_foreign(void *map_addr)
+{
+  return wilde_map_rm_internal(map_addr, false, 0, true, NULL);
+}
+#endif
+
+void *wilde_map_resize(void *map_addr, size_t size)
+{
+  struct alias *a = (struct alias *)alias_search((uintptr_t)map_addr);
+  UK_ASSERT(a && size <= a->size);
+
+  STAT_LIVE_SUB(a->alias, a->size);
+  PROFILE_RESIZE(a, size);
+  a->size = size;
+  STAT_LIVE_ADD(a->alias, size);
+
+  return (void *)a->origin;
+}
+
+size_t wilde_map_usable(void *map_addr)
+{
+  const struct alias *a = alias_search((uintptr_t)map_addr);
+  return a ? wilde_usable(a->alias, a->size) : 0;
+}
+
 void *wilde_map_get(void *map_addr)
 {
   const struct alias *a = alias_search((uintptr_t)map_addr);
@@ -230,15 +654,87 @@ void *wilde_map_get(void *map_addr)
   return (void *)a->origin;
 }
 
-static void wilde_init(void)
+static void wilde_verify_alias(struct wilde_verify *v, const struct alias *a)
 {
-  uk_pr_info("Initialising lib wilde\n");
+  uintptr_t page_start = ROUNDDOWN(a->alias, __PAGE_SIZE);
+  uintptr_t page_end = ROUNDUP(a->alias + a->size, __PAGE_SIZE);
+  uintptr_t origin = ROUNDDOWN(a->origin, __PAGE_SIZE);
+
+  v->aliases++;
+  if (!wilde_is_alias((void *)a->alias) ||
+      (a->alias & MASK_4KB) != (a->origin & MASK_4KB)) {
+    v->bad_aliases++;
+    return;
+  }
+
+  for (uintptr_t page = page_start; page < page_end; page += __PAGE_SIZE) {
+#ifdef CONFIG_LIBWILDE_RELEASE
+    /* released pages are unmapped, recommitted ones mapped anywhere */
+    if (a->flags & ALIAS_RELEASED) {
+      v->pages += pt_get_phys(page) != 0;
+      continue;
+    }
+#endif
+    v->pages++;
+    if (pt_get_phys(page) != origin + (page - page_start))
+      v->bad_pages++;
+  }
+
+#ifdef CONFIG_LIBWILDE_SHAUN
+  if (pt_get_phys(page_end))
+    v->bad_guards++;
+#endif
+}
+
+bool wilde_map_verify(struct wilde_verify *out)
+{
+  struct wilde_verify v = {0};
+
+  for (int i = 0; i < LOOKUP_SIZE; i++) {
+    struct alias *iter;
+    uk_list_for_each_entry(iter, &lookup[i], list)
+      wilde_verify_alias(&v, iter);
+  }
+
+  v.mapped = pt_count_mapped(VMAP_START, VMAP_START + VMAP_SIZE);
+
+  /* vma_split keeps vmem_free sorted, nothing ever goes back in */
+  uintptr_t last_end = VMAP_START;
+  size_t free_bytes = 0;
+  struct vma *iter;
+  uk_list_for_each_entry(iter, &vmem_free, list) {
+    v.free_vmas++;
+    if (!iter->size || VMA_BEGIN(iter) < last_end ||
+        VMA_END(iter) > VMAP_PALLOC_START)
+      v.bad_vmas++;
+    last_end = VMA_END(iter);
+    free_bytes += iter->size;
+  }
+
+  /* the running count has to agree, a vma is as good as lost otherwise */
+  if (free_bytes != vmem_free_bytes)
+    v.bad_vmas++;
 
 #ifdef CONFIG_LIBWILDE_ASLR
-  uk_pr_crit("Seeding the ASLR with compile time included /dev/urandom data, %x\n", WILDE_SEED);
-  uk_swrand_init_r(&wilde_rand, WILDE_SEED);
+  v.bad_vmas += aslr_verify();
 #endif
 
+#ifdef CONFIG_LIBWILDE_ARENA
+  /* arena pages are mapped without an alias of their own */
+  arena_verify(&v);
+#endif
+
+  if (out)
+    *out = v;
+
+  return !v.bad_aliases && !v.bad_pages && !v.bad_guards && !v.bad_vmas &&
+         v.mapped == v.pages;
+}
+
+static void wilde_init(void)
+{
+  uk_pr_info("Initialising lib wilde\n");
+
 #ifdef CONFIG_LIBWILDE_NX
   uk_pr_info("Enabling the NX-bit\n");
   write_msr(EFER_REGISTER, read_msr(EFER_REGISTER) | EFER_NXE);
@@ -250,6 +746,11 @@ static void wilde_init(void)
   /* set up alias hash table */
   alias_init();
 
+#ifdef CONFIG_LIBWILDE_POLICY
+  /* load the boot time protection policy */
+  policy_init();
+#endif
+
   /* print memory usage */
   uk_pr_info("vspace size: ");
   print_sz(VMAP_SIZE);
@@ -2,15 +2,41 @@
 #define __WILDE_INTERNAL_H__
 
 #include <uk/list.h>
+#include <stdbool.h>
+#include <wilde.h>
+#include "util.h"
+
+/*
+ * The alias window, 3TB of virtual memory starting at 4TB. The top TB of it is
+ * the palloc window (see vbuddy.h), the rest goes to malloc & co.
+ */
+#define VMAP_START ((4 * TB))
+#define VMAP_SIZE  ((3 * TB))
+
+#define VMAP_PALLOC_SIZE  ((1 * TB))
+#define VMAP_PALLOC_START ((VMAP_START + VMAP_SIZE - VMAP_PALLOC_SIZE))
+
+/* whether addr lies in the alias window, i.e. whether wilde handed it out */
+static inline bool wilde_is_alias(const void *addr)
+{
+  return (uintptr_t)addr - VMAP_START < VMAP_SIZE;
+}
+
+/*
+ * the bytes usable at an alias of size bytes, up to the end of its last page.
+ * That tail is mapped and belongs to the allocation: kallocs puts objects at
+ * the end of their block, the backing malloc gives every object its own pages
+ */
+static inline size_t wilde_usable(uintptr_t alias, size_t size)
+{
+  return ROUNDUP(alias + size, __PAGE_SIZE) - alias;
+}
 
 extern struct uk_list_head vmem_free; /* vmem chunks ready for use */
 extern struct uk_list_head vmem_gc;   /* vmem chunks ready for gc */
 
-#ifdef CONFIG_LIBWILDE_ASLR
-#include <uk/swrand.h>
-
-extern struct uk_swrand    wilde_rand; /* random number generator for wilde */
-#endif
+/* bytes left in the malloc window, a running count, no walk */
+size_t vmem_remaining(void);
 
 /*
  * wilde internals
@@ -35,20 +61,111 @@ void wilde_map_init();
  */
 void *wilde_map_new(void *real_addr, size_t size, size_t align);
 
+/*
+ * same as wilde_map_new, but always reserves an unmapped guard page behind the
+ * mapping, as CONFIG_LIBWILDE_SHAUN does for all of them
+ */
+void *wilde_map_new_guard(void *real_addr, size_t size, size_t align);
+
+/*
+ * @success: returns the new mapping of the __PAGE_SIZE << order bytes at
+ * real_addr, aligned to its own size
+ * @fail: crash
+ *
+ * Like wilde_map_new(real_addr, __PAGE_SIZE << order, __PAGE_SIZE << order),
+ * but served from the palloc window so it doesn't fragment the malloc one
+ */
+void *wilde_map_new_palloc(void *real_addr, size_t order);
+
+/*
+ * @success: returns the start of size bytes of the malloc window, followed by
+ *           a guard page under SHAUN, nothing mapped in
+ * @fail:    returns 0
+ *
+ * For callers mapping in the range themselves, like arenas
+ */
+uintptr_t wilde_map_reserve(size_t size);
+
 /*
  * @success removes a mapping for forever, never to be used again, and disallows
  *          anyone accessing it, (given out_size != NULL), will fill it with size
  *
  * @failure: if mapping doesn't exist, doesn't touch anything, leaves out_size untouched
  *
- * returns the mapping it removed (or NULL)
+ * returns the mapping it removed (or NULL), or WILDE_MAP_FREED for one
+ * wilde_map_release punched holes into, its memory is given back already
  */
+#define WILDE_MAP_FREED ((void *)1)
+
 void *wilde_map_rm(void *map_addr, size_t *out_size);
 
+/*
+ * same as wilde_map_rm, but only removes a mapping when size lies between its
+ * size and its usable size, returns NULL without touching anything otherwise
+ */
+void *wilde_map_rm_sized(void *map_addr, size_t size, size_t *out_size);
+
+/*
+ * shrinks the size a mapping was registered with to size, for objects
+ * prepared before the size they'd be used at was known
+ *
+ * returns the real address
+ */
+void *wilde_map_resize(void *map_addr, size_t size);
+
+/* usable size of a mapping, see wilde_usable, 0 if it doesn't exist */
+size_t wilde_map_usable(void *map_addr);
+
+#ifdef CONFIG_LIBWILDE_FOREIGN
+/*
+ * @success: returns a new mapping of the len bytes at buf, identity mapped
+ *           memory or an alias of physically contiguous memory, that
+ *           wilde_map_rm and wilde_map_rm_sized refuse
+ * @fail:    returns NULL for any other buf
+ */
+void *wilde_map_new_foreign(const void *buf, size_t len);
+
+/* wilde_map_rm for mappings of wilde_map_new_foreign only */
+void *wilde_map_rm_foreign(void *map_addr);
+#endif
+
+#ifdef CONFIG_LIBWILDE_RELEASE
+/*
+ * unmaps the whole pages of [off, off + len) of the malloc & co mapping at
+ * map_addr and gives their memory back, the range stays reserved to it
+ *
+ * returns the bytes given back, -EINVAL when there's no such mapping or the
+ * range goes past its usable size
+ */
+ssize_t wilde_map_release(void *map_addr, size_t off, size_t len);
+
+/*
+ * maps zeroed pages in for the unmapped pages of [off, off + len), returns
+ * the bytes mapped in, -EINVAL as wilde_map_release and -ENOMEM when the
+ * backing allocator ran out
+ */
+ssize_t wilde_map_recommit(void *map_addr, size_t off, size_t len);
+
+/* whether pages of the mapping at map_addr were ever released */
+bool wilde_map_released(void *map_addr);
+
+/*
+ * copies up to size bytes of the mapping at map_addr to the physical memory
+ * at dst, stopping at its usable size, released pages read as 0
+ */
+void wilde_map_copy(void *dst, void *map_addr, size_t size);
+#endif
+
 /*
  * @success: returns the address of the real address
  * @fail:    if nothing found, returns NULL
  */
 void *wilde_map_get(void *map_addr);
 
+/*
+ * checks the alias table, page tables and vmem_free against each other, see
+ * wilde_verify, expects the caller to hold the allocator lock
+ */
+bool wilde_map_verify(struct wilde_verify *out);
+
 #endif // __WILDE_INTERNAL_H__
@@ -1,43 +1,90 @@
 #ifndef __WILDE_X86_H__
 #define __WILDE_X86_H__
 #include "util.h"
+#include "percpu.h"
 #include <stdbool.h>
 
+#ifdef WILDE_HOST
+/*
+ * Host build, the control registers, MSRs and TLB are simulated, page tables
+ * are walked but never loaded. Flushes only count, see host/host.c.
+ */
+extern uintptr_t host_cr3;
+extern uintptr_t host_cr4;
+extern u64 host_efer;
+extern u64 host_cr3_writes;
+extern u64 host_invlpgs;
 
 static __inline void lcr3(uintptr_t val)
 {
-  __asm __volatile("movq %0,%%cr3" : : "r"(val));
+  host_cr3 = val;
+  host_cr3_writes++;
 }
 
 static __inline uintptr_t rcr3(bool use_cache)
 {
-  static uintptr_t val = 0;
-  if (!val || !use_cache)
-    __asm __volatile("movq %%cr3,%0" : "=r"(val));
+  UNUSED(use_cache);
+  return host_cr3;
+}
 
-  return val;
+static __inline void wcr4(uintptr_t val)
+{
+  host_cr4 = val;
 }
 
-#define CR4_VME        POW2(0)
-#define CR4_PVI        POW2(1)
-#define CR4_TSD        POW2(2)
-#define CR4_DE         POW2(3)
-#define CR4_PSE        POW2(4)
-#define CR4_PAE        POW2(5)
-#define CR4_MCE        POW2(6)
-#define CR4_PGE        POW2(7)
-#define CR4_PCE        POW2(8)
-#define CR4_OSFXSR     POW2(9)
-#define CR4_OSXMMEXCPT POW2(10)
-#define CR4_UMIP       POW2(11)
-#define CR4_VMXE       POW2(13)
-#define CR4_SMXE       POW2(14)
-#define CR4_FSGBASE    POW2(16)
-#define CR4_PCIDE      POW2(17)
-#define CR4_OSXSAVE    POW2(18)
-#define CR4_SMEP       POW2(20)
-#define CR4_SMAP       POW2(21)
-#define CR4_PKE        POW2(22)
+static __inline uintptr_t rcr4(void)
+{
+  return host_cr4;
+}
+
+static __inline void tlbflush_page(uintptr_t vaddr)
+{
+  UNUSED(vaddr);
+  host_invlpgs++;
+}
+
+static __inline void tlbflush(void)
+{
+  host_cr3_writes++;
+}
+
+static __inline u64 read_msr(u32 identifier)
+{
+  UNUSED(identifier);
+  return host_efer;
+}
+
+static __inline void write_msr(u32 identifier, u64 value)
+{
+  UNUSED(identifier);
+  host_efer = value;
+}
+
+/* no hardware entropy, host runs only depend on WILDE_SEED */
+static __inline bool rdrand64(u64 *out)
+{
+  UNUSED(out);
+  return false;
+}
+
+#else
+
+static __inline void lcr3(uintptr_t val)
+{
+  __asm __volatile("movq %0,%%cr3" : : "r"(val));
+}
+
+/* the cache is per CPU, each may run on page tables of its own */
+static __inline uintptr_t rcr3(bool use_cache)
+{
+  static uintptr_t cached[WILDE_NR_CPUS];
+  uintptr_t *val = &PERCPU(cached);
+
+  if (!*val || !use_cache)
+    __asm __volatile("movq %%cr3,%0" : "=r"(*val));
+
+  return *val;
+}
 
 static __inline void wcr4(uintptr_t val)
 {
@@ -51,10 +98,10 @@ static __inline uintptr_t rcr4(void)
   return val;
 }
 
-/* flushes tbl only for a specific physical page */
-static __inline void tlbflush_phys(uintptr_t addr)
+/* flushes the tlb only for the page at vaddr */
+static __inline void tlbflush_page(uintptr_t vaddr)
 {
-  __asm __volatile("invlpg (%0)" ::"r" (addr) : "memory");
+  __asm __volatile("invlpg (%0)" ::"r" (vaddr) : "memory");
 }
 
 static __inline void tlbflush(void)
@@ -83,6 +130,60 @@ static __inline void write_msr(u32 identifier, u64 value)
   asm volatile("wrmsr" : : "a"(low), "d"(high), "c"(identifier));
 }
 
+/*
+ * RDRAND, false when the CPU doesn't have it or it keeps running dry. cpuid
+ * traps to the hypervisor, so it's only asked once.
+ */
+static __inline bool rdrand64(u64 *out)
+{
+  static int has_rdrand = -1;
+
+  if (has_rdrand < 0) {
+    u32 eax = 1, ebx, ecx = 0, edx;
+    __asm __volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    has_rdrand = !!(ecx & POW2(30));
+  }
+
+  for (int i = 0; has_rdrand && i < 10; i++) {
+    u8 ok;
+    __asm __volatile("rdrand %0; setc %1" : "=r"(*out), "=qm"(ok));
+    if (ok)
+      return true;
+  }
+
+  return false;
+}
+
+#endif /* WILDE_HOST */
+
+#define CR4_VME        POW2(0)
+#define CR4_PVI        POW2(1)
+#define CR4_TSD        POW2(2)
+#define CR4_DE         POW2(3)
+#define CR4_PSE        POW2(4)
+#define CR4_PAE        POW2(5)
+#define CR4_MCE        POW2(6)
+#define CR4_PGE        POW2(7)
+#define CR4_PCE        POW2(8)
+#define CR4_OSFXSR     POW2(9)
+#define CR4_OSXMMEXCPT POW2(10)
+#define CR4_UMIP       POW2(11)
+#define CR4_VMXE       POW2(13)
+#define CR4_SMXE       POW2(14)
+#define CR4_FSGBASE    POW2(16)
+#define CR4_PCIDE      POW2(17)
+#define CR4_OSXSAVE    POW2(18)
+#define CR4_SMEP       POW2(20)
+#define CR4_SMAP       POW2(21)
+#define CR4_PKE        POW2(22)
+
+/* time stamp counter, for latency measurements */
+static __inline u64 rdtsc(void)
+{
+  u32 low, high;
+  __asm __volatile("rdtsc" : "=a"(low), "=d"(high));
+  return ((u64)high << 32) | low;
+}
 
 #define EFER_REGISTER 0xC0000080
 #define EFER_NXE POW2(11)